@@ -1,6 +1,8 @@
 #pragma once
 
 #include <eosio/asset.hpp>
+#include <eosio/binary_extension.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/privileged.hpp>
 #include <eosio/singleton.hpp>
 #include <eosio/system.hpp>
@@ -29,7 +31,28 @@ namespace OrderStatus {
     static constexpr eosio::name OK{"ok"_n };
     static constexpr eosio::name NOK{"nok"_n };
     static constexpr eosio::name PENDING{"pending"_n };
+    static constexpr eosio::name EXPIRED{"expired"_n };
 }
+
+enum class order_status_code: uint8_t {
+    NONE                = 0,
+    OK                  = 1,
+    NOK                 = 2,
+    PENDING             = 3,
+    EXPIRED             = 4
+};
+
+inline uint8_t to_status_code(const name& status) {
+    switch( status.value ) {
+        case OrderStatus::OK.value:         return (uint8_t) order_status_code::OK;
+        case OrderStatus::NOK.value:        return (uint8_t) order_status_code::NOK;
+        case OrderStatus::PENDING.value:    return (uint8_t) order_status_code::PENDING;
+        case OrderStatus::EXPIRED.value:    return (uint8_t) order_status_code::EXPIRED;
+        default:                            return (uint8_t) order_status_code::NONE;
+    }
+}
+
+static constexpr uint32_t seconds_per_day       = 24 * 3600;
 struct aplink_farm {
     name contract           = "aplink.farm"_n;
     uint64_t lease_id       = 5;    //nftone-farm-land
@@ -47,6 +70,23 @@ NTBL("global") global_t {
 };
 typedef eosio::singleton< "global"_n, global_t > global_singleton;
 
+NTBL("global2") global_t2 {
+    uint32_t                    order_lease_seconds  = 600; //how long a leased order is held by one auditor
+    uint32_t                    order_expiry_seconds = 30 * seconds_per_day;
+    bool                        refund_expired       = true;   //refund the charge of expired orders, or forward it to fee_collector
+    uint64_t                    sweep_vendor_cursor  = 0;      //vendor shard the expiry sweeper resumes from
+    asset                       farm_apples;                   //cached available apples of apl_farm lease
+    time_point_sec              farm_checked_at;
+    uint32_t                    farm_check_seconds   = 3600;   //refresh interval of farm_apples
+    uint64_t                    lease_vendor_cursor  = 0;      //vendor shard the next lease starts from
+    bool                        orders_migrated      = false;  //legacy orders table drained, set by migrateorders
+
+    EOSLIB_SERIALIZE( global_t2, (order_lease_seconds)(order_expiry_seconds)(refund_expired)(sweep_vendor_cursor)
+                                 (farm_apples)(farm_checked_at)(farm_check_seconds)(lease_vendor_cursor)(orders_migrated) )
+};
+typedef eosio::singleton< "global2"_n, global_t2 > global_singleton2;
+
+//Scope: _self, legacy layout drained into ordersv2 by migrateorders
 TBL order_t {
     uint64_t        id;                 //PK
     name            applicant;
@@ -69,6 +109,82 @@ TBL order_t {
     EOSLIB_SERIALIZE( order_t, (id)(applicant)(vendor_account)(kyc_level)(secret_md5)(created_at) )
 };
 
+//Scope: vendor_account
+TBL order_v2_t {
+    name            applicant;          //PK, one open order per applicant
+    uint64_t        id;                 //sequential order id, resolved through applicant_t::by_order_id
+    uint64_t        vendor_id;          //vendor_info_t::id, 0 if unresolved on migration
+    int64_t         paid;               //charge paid by the applicant in the vendor's user_charge_quant symbol
+    uint128_t       secret_md5;         //see to_secret_digest
+    time_point_sec  created_at;
+    time_point_sec  available_at;       //order can be leased from this time on
+    uint8_t         kyc_level;
+    uint8_t         status;             //order_status_code
+
+    order_v2_t() {}
+    order_v2_t(const name& a): applicant(a) {}
+
+    uint64_t primary_key()const { return applicant.value; }
+    uint64_t by_queue() const { return ((uint64_t) available_at.sec_since_epoch() << 32) | (id & 0x00000000FFFFFFFF); }
+
+    //parses a 32-char hex md5 string, digest holds its 16 bytes in memory order, as packed by pack()
+    static bool parse_md5(string_view hex, uint128_t& digest) {
+        if (hex.size() != 32) return false;
+
+        uint8_t bytes[16] = {};
+        for (size_t i = 0; i < hex.size(); i++) {
+            auto c = hex[i];
+            uint8_t nibble;
+            if (c >= '0' && c <= '9')       nibble = c - '0';
+            else if (c >= 'a' && c <= 'f')  nibble = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')  nibble = c - 'A' + 10;
+            else return false;
+            bytes[i / 2] = (bytes[i / 2] << 4) | nibble;
+        }
+        memcpy(&digest, bytes, sizeof(digest));
+        return true;
+    }
+
+    //binary md5 of a 32-char hex secret, or the leading 16 bytes of sha256 for any other secret,
+    //in both cases laid out in memory, and so packed, in digest byte order
+    static uint128_t to_secret_digest(string_view secret) {
+        uint128_t digest;
+        if (parse_md5(secret, digest)) return digest;
+
+        auto hash = sha256(secret.data(), secret.size()).extract_as_byte_array();
+        memcpy(&digest, hash.data(), sizeof(digest));
+        return digest;
+    }
+
+    typedef eosio::multi_index
+    < "ordersv2"_n,  order_v2_t,
+        indexed_by<"queueidx"_n,     const_mem_fun<order_v2_t, uint64_t, &order_v2_t::by_queue> >
+    > idx_t;
+
+    EOSLIB_SERIALIZE( order_v2_t, (applicant)(id)(vendor_id)(paid)(secret_md5)(created_at)(available_at)
+                                  (kyc_level)(status) )
+};
+
+//Scope: _self, maps each applicant to the vendor shard holding its order
+TBL applicant_t {
+    name            applicant;          //PK
+    name            vendor_account;
+    uint64_t        order_id;
+
+    applicant_t() {}
+    applicant_t(const name& a): applicant(a) {}
+
+    uint64_t primary_key()const { return applicant.value; }
+    uint64_t by_order_id()const { return order_id; }
+
+    typedef eosio::multi_index
+    < "applicants"_n,  applicant_t,
+        indexed_by<"orderidx"_n,     const_mem_fun<applicant_t, uint64_t, &applicant_t::by_order_id> >
+    > idx_t;
+
+    EOSLIB_SERIALIZE( applicant_t, (applicant)(vendor_account)(order_id) )
+};
+
 //Scope: nasset.symbol.id
 TBL vendor_info_t {
     uint64_t        id;                 //PK
@@ -81,12 +197,17 @@ TBL vendor_info_t {
     name            status;
     time_point_sec  created_at;
     time_point_sec  updated_at;
+    binary_extension<public_key> pubkey;    //key signing KYC results submitted through settle
 
     vendor_info_t() {}
     vendor_info_t(const uint64_t& i): id(i) {}
 
     uint64_t primary_key()const { return id; }
-    uint128_t by_vendor_account_and_kyc_level() const { return ((uint128_t) vendor_account.value << 64) + kyc_level ; }
+    uint128_t by_vendor_account_and_kyc_level() const { return make_key( vendor_account, kyc_level ); }
+
+    static uint128_t make_key(const name& vendor_account, const uint32_t& kyc_level) {
+        return ((uint128_t) vendor_account.value << 64) | kyc_level;
+    }
 
     typedef eosio::multi_index
     < "vendorinfo"_n,  vendor_info_t,
@@ -95,9 +216,73 @@ TBL vendor_info_t {
 
     EOSLIB_SERIALIZE( vendor_info_t, (id)(vendor_name)(vendor_account)(kyc_level)
                                      (user_reward_quant)(user_charge_quant)
-                                     (nft_id)(status)(created_at)(updated_at) )
+                                     (nft_id)(status)(created_at)(updated_at)(pubkey) )
+};
+
+//Scope: _self, KYC pipeline counters per vendor
+TBL vendor_stats_t {
+    uint64_t        vendor_id;          //PK
+    uint64_t        received        = 0;
+    uint64_t        approved        = 0;
+    uint64_t        rejected        = 0;
+    uint64_t        expired         = 0;
+    uint64_t        pending         = 0;    //orders currently marked pending
+    uint64_t        total_latency   = 0;    //seconds from created_at to settlement, over approved and rejected
+    vector<uint64_t> latency_buckets;       //settled order count per latency_bounds bucket, plus one overflow bucket
+
+    static constexpr uint32_t latency_bounds[] = { 600, 3600, 6 * 3600, seconds_per_day, 3 * seconds_per_day, 7 * seconds_per_day };
+    static constexpr size_t   latency_bucket_count = sizeof(latency_bounds) / sizeof(latency_bounds[0]) + 1;
+
+    vendor_stats_t() {}
+    vendor_stats_t(const uint64_t& i): vendor_id(i), latency_buckets(latency_bucket_count, 0) {}
+
+    uint64_t primary_key()const { return vendor_id; }
+
+    void add_latency(const uint32_t& seconds) {
+        size_t bucket = 0;
+        while (bucket < latency_bucket_count - 1 && seconds >= latency_bounds[bucket]) bucket++;
+        latency_buckets[bucket]++;
+        total_latency += seconds;
+    }
+
+    typedef eosio::multi_index< "vendorstats"_n,  vendor_stats_t > idx_t;
+
+    EOSLIB_SERIALIZE( vendor_stats_t, (vendor_id)(received)(approved)(rejected)(expired)(pending)
+                                      (total_latency)(latency_buckets) )
+};
+
+//Scope: _self, settlement fees accrued per token symbol until swept to fee_collector
+TBL fee_t {
+    asset           accrued;            //PK: accrued.symbol.code()
+    time_point_sec  swept_at;
+
+    fee_t() {}
+    fee_t(const asset& quant): accrued(quant) {}
+
+    uint64_t primary_key()const { return accrued.symbol.code().raw(); }
+
+    typedef eosio::multi_index< "fees"_n,  fee_t > idx_t;
+
+    EOSLIB_SERIALIZE( fee_t, (accrued)(swept_at) )
+};
+
+//Scope: _self, APL rewards waiting to be allotted by flushrewards
+TBL reward_t {
+    name            farmer;             //PK
+    asset           quantity;
+    time_point_sec  updated_at;
+
+    reward_t() {}
+    reward_t(const name& f): farmer(f) {}
+
+    uint64_t primary_key()const { return farmer.value; }
+
+    typedef eosio::multi_index< "rewards"_n,  reward_t > idx_t;
+
+    EOSLIB_SERIALIZE( reward_t, (farmer)(quantity)(updated_at) )
 };
 
+//legacy pending marks, folded into order_v2_t::status by migrateorders
 TBL pending_t {
     uint64_t        order_id;                 //PK
 
@@ -4,6 +4,7 @@
 #include <eosio/eosio.hpp>
 #include <eosio/permission.hpp>
 #include <eosio/action.hpp>
+#include <eosio/crypto.hpp>
 
 #include <string>
 
@@ -27,6 +28,8 @@ using namespace eosio;
 
 static constexpr name      NFT_BANK    = "did.ntoken"_n;
 static constexpr eosio::name active_perm{"active"_n};
+static constexpr uint32_t  MAX_SETTLE_BATCH    = 300;
+static constexpr uint32_t  MAX_QUERY_LIMIT     = 100;
 
 
 enum class err: uint8_t {
@@ -55,6 +58,52 @@ namespace vendor_info_status {
     static constexpr eosio::name STOP               = "stop"_n;
 };
 
+struct order_result_t {
+   uint64_t          order_id;
+   name              status;
+   string            msg;
+
+   EOSLIB_SERIALIZE( order_result_t, (order_id)(status)(msg) )
+};
+
+struct audit_t {
+   uint64_t          order_id;
+   name              applicant;
+   uint64_t          vendor_id;
+   uint8_t           status;              //order_status_code
+   std::optional<checksum256> msg_hash;   //sha256 of the auditor msg, if any
+
+   EOSLIB_SERIALIZE( audit_t, (order_id)(applicant)(vendor_id)(status)(msg_hash) )
+};
+
+struct settle_failure_t {
+   uint64_t          order_id;
+   uint8_t           err_code;
+
+   EOSLIB_SERIALIZE( settle_failure_t, (order_id)(err_code) )
+};
+
+struct order_info_t {
+   name              vendor_account;
+   order_v2_t        order;
+
+   EOSLIB_SERIALIZE( order_info_t, (vendor_account)(order) )
+};
+
+struct order_page_t {
+   vector<order_v2_t>      orders;
+   name                    next_cursor;   //empty when there are no more rows
+
+   EOSLIB_SERIALIZE( order_page_t, (orders)(next_cursor) )
+};
+
+struct vendor_page_t {
+   vector<vendor_info_t>   vendors;
+   uint64_t                next_cursor = 0;  //0 when there are no more rows
+
+   EOSLIB_SERIALIZE( vendor_page_t, (vendors)(next_cursor) )
+};
+
 /**
  * The `amax.did` sample system contract defines the structures and actions that allow users to create, issue, and manage tokens for AMAX based blockchains. It demonstrates one way to implement a smart contract which allows for creation and management of tokens. It is possible for one to create a similar contract which suits different needs. However, it is recommended that if one only needs a token with the below listed actions, that one uses the `amax.did` contract instead of developing their own.
  *
@@ -73,12 +122,22 @@ class [[eosio::contract("amax.did")]] amax_did : public contract {
   
    amax_did(eosio::name receiver, eosio::name code, datastream<const char*> ds): contract(receiver, code, ds),
          _dbc(get_self()),
-         _global(get_self(), get_self().value)
+         _global(get_self(), get_self().value),
+         _global2(get_self(), get_self().value)
     {
-        _gstate = _global.exists() ? _global.get() : global_t{};
+        _gstate  = _global.exists() ? _global.get() : global_t{};
+        _gstate2 = _global2.exists() ? _global2.get() : global_t2{};
+        _gstate_packed  = pack( _gstate );
+        _gstate2_packed = pack( _gstate2 );
     }
 
-    ~amax_did() { _global.set( _gstate, get_self() ); }
+    ~amax_did() {
+        //globals are only written back when the action changed them, so queries write nothing
+        if (pack( _gstate ) != _gstate_packed)
+            _global.set( _gstate, get_self() );
+        if (pack( _gstate2 ) != _gstate2_packed)
+            _global2.set( _gstate2, get_self() );
+    }
 
 
    [[eosio::on_notify("amax.token::transfer")]]
@@ -94,6 +153,140 @@ class [[eosio::contract("amax.did")]] amax_did : public contract {
 
    ACTION setdidstatus (const uint64_t& order_id, const name& status, const string& msg );
 
+   /**
+    * @brief settle a batch of KYC orders in one transaction
+    *
+    * Orders that cannot be settled are skipped and reported through `settlelog`
+    * instead of aborting the whole batch.
+    *
+    * @param results - up to MAX_SETTLE_BATCH {order_id, status, msg} entries
+    */
+   ACTION setdidstatuses( const vector<order_result_t>& results );
+
+   /**
+    * @brief settle a KYC order with a result signed by its vendor, any relayer may submit it
+    *
+    * The vendor signs sha256 over 48 bytes: contract name (8, little-endian), order_id (8, little-endian),
+    * the 16 secret digest bytes and status name (8, little-endian). The digest bytes are the md5 bytes
+    * when the secret in the transfer memo is 32 hex chars, in the order the hex string spells them,
+    * else the first 16 bytes of sha256(memo secret).
+    *
+    * @param order_id - order to settle
+    * @param status - OrderStatus::OK or OrderStatus::NOK
+    * @param sig - vendor signature over sha256(pack(_self, order_id, secret_md5, status))
+    */
+   ACTION settle( const uint64_t& order_id, const name& status, const signature& sig );
+
+   ACTION setvendkey( const uint64_t& vendor_id, const public_key& pubkey );
+
+   /**
+    * @brief convert legacy order rows in the _self scope into compact rows of their vendor shards
+    *
+    * Once the legacy table is empty, intake and lookups stop probing it.
+    *
+    * @param max_rows - max number of order rows to migrate
+    */
+   ACTION migrateorders( const uint64_t& max_rows );
+
+   /**
+    * @brief lease up to `max_rows` queued orders to one auditor, oldest first within each vendor shard
+    *
+    * Leased orders move behind the lease expiry in the queue, so concurrent
+    * auditors are handed disjoint orders until the lease runs out. Each call starts
+    * from the vendor shard after the one the previous call started from, so every
+    * shard gets served in turn, and visits at most `max_rows` vendors.
+    *
+    * @param auditor - auditor worker taking the lease, must sign along with admin
+    * @param max_rows - max number of orders to lease
+    */
+   ACTION lease( const name& auditor, const uint32_t& max_rows );
+
+   ACTION setleasesecs( const uint32_t& seconds ) {
+      require_auth( _self );
+      CHECK( seconds > 0, "lease seconds must be positive" )
+
+      _gstate2.order_lease_seconds = seconds;
+   }
+
+   /**
+    * @brief erase stale orders, walking the queue of each vendor shard
+    *
+    * An order is stale once it was neither created, leased nor requeued within the expiry
+    * period, so orders still being polled by auditors are kept.
+    *
+    * The charge of each expired order is refunded to the applicant, or forwarded to
+    * fee_collector when refunds are disabled.
+    *
+    * @param max_rows - max number of orders to erase
+    */
+   ACTION sweeporders( const uint64_t& max_rows );
+
+   /**
+    * @brief transfer all accrued settlement fees to fee_collector, one transfer per symbol
+    */
+   ACTION sweepfees();
+
+   /**
+    * @brief allot pending APL rewards, checking the farm availability at most once per refresh interval
+    *
+    * @param max_rows - max number of reward rows to visit, rewards the farm cannot cover are skipped
+    */
+   ACTION flushrewards( const uint64_t& max_rows );
+
+   ACTION setfarmcheck( const uint32_t& seconds ) {
+      require_auth( _self );
+      CHECK( seconds > 0, "farm check seconds must be positive" )
+
+      _gstate2.farm_check_seconds = seconds;
+   }
+
+   ACTION setexpiry( const uint32_t& expiry_seconds, const bool& refund_expired ) {
+      require_auth( _self );
+      CHECK( expiry_seconds > 0, "expiry seconds must be positive" )
+
+      _gstate2.order_expiry_seconds = expiry_seconds;
+      _gstate2.refund_expired       = refund_expired;
+   }
+
+   //Queries change no state. Their result is an inline log action sent from amax.did@active, the same
+   //eosio.code permission its transfers already use, and is read from the trace of a transaction the
+   //caller signs and pays CPU for. RPC readers can read the tables named below with get_table_rows instead.
+
+   /**
+    * @brief query the open order of an applicant, reported through an inline `orderlog`
+    *
+    * Table read: `applicants` (scope amax.did, key applicant), then `ordersv2` (scope vendor_account, key applicant).
+    */
+   ACTION getorder( const name& applicant );
+
+   /**
+    * @brief query one page of a vendor shard's orders in applicant order, reported through an inline `orderslog`
+    *
+    * Table read: `ordersv2`, scope vendor_account.
+    *
+    * @param vendor_account - vendor shard to list
+    * @param cursor - applicant to resume from, `next_cursor` of the previous page
+    * @param limit - max number of orders, up to MAX_QUERY_LIMIT
+    */
+   ACTION listorders( const name& vendor_account, const name& cursor, const uint32_t& limit );
+
+   /**
+    * @brief query one page of vendors in id order, reported through an inline `vendorslog`
+    *
+    * Table read: `vendorinfo`, scope amax.did.
+    *
+    * @param cursor - vendor id to resume from, `next_cursor` of the previous page
+    * @param limit - max number of vendors, up to MAX_QUERY_LIMIT
+    */
+   ACTION listvendors( const uint64_t& cursor, const uint32_t& limit );
+
+   /**
+    * @brief query the KYC pipeline counters and latency histogram of a vendor, reported through an inline `vendstatlog`
+    *
+    * Table read: `vendorstats` (scope amax.did, key vendor_id).
+    */
+   ACTION getvendstats( const uint64_t& vendor_id );
+
    ACTION  addvendor(const string& vendor_name,
                      const name& vendor_account,
                      uint32_t& kyc_level,
@@ -106,47 +299,103 @@ class [[eosio::contract("amax.did")]] amax_did : public contract {
                            const asset& user_charge_quant, 
                            const nsymbol& nft_id ) ;
 
-    ACTION auditlog( 
-                     const uint64_t& order_id,
-                     const name& taker,
-                     const string& vendor_name,
-                     const name& vendor_account,
-                     uint32_t& kyc_level,
-                     const asset& vendor_charge_quant,
-                     const name& status,
-                     const string& msg,
-                     const time_point& created_at);
+    ACTION auditlog( const uint64_t& order_id,
+                     const name& applicant,
+                     const uint64_t& vendor_id,
+                     const uint8_t& status,
+                     const std::optional<checksum256>& msg_hash );
 
     using auditlog_action = eosio::action_wrapper<"auditlog"_n, &amax_did::auditlog>;
 
+    ACTION auditlogs( const vector<audit_t>& audits );
+
+    using auditlogs_action = eosio::action_wrapper<"auditlogs"_n, &amax_did::auditlogs>;
+
+    ACTION settlelog( const vector<settle_failure_t>& failures );
+
+    using settlelog_action = eosio::action_wrapper<"settlelog"_n, &amax_did::settlelog>;
+
+    ACTION leaselog( const name& auditor, const vector<uint64_t>& order_ids, const time_point_sec& expired_at );
+
+    using leaselog_action = eosio::action_wrapper<"leaselog"_n, &amax_did::leaselog>;
+
+    ACTION orderlog( const order_info_t& info );
+
+    using orderlog_action = eosio::action_wrapper<"orderlog"_n, &amax_did::orderlog>;
+
+    ACTION orderslog( const order_page_t& page );
+
+    using orderslog_action = eosio::action_wrapper<"orderslog"_n, &amax_did::orderslog>;
+
+    ACTION vendorslog( const vendor_page_t& page );
+
+    using vendorslog_action = eosio::action_wrapper<"vendorslog"_n, &amax_did::vendorslog>;
+
+    ACTION vendstatlog( const vendor_stats_t& stats );
+
+    using vendstatlog_action = eosio::action_wrapper<"vendstatlog"_n, &amax_did::vendstatlog>;
+
    ACTION setcollector(const name&  fee_collector ) {
       require_auth( _self );
       _gstate.fee_collector = fee_collector;
    }
 
+   private:
+      //per-action settlement side effects, flushed once at the end of the action
+      struct settle_batch_t {
+         vector<audit_t>               audits;
+         map<symbol_code, asset>       fees;
+         map<name, asset>              rewards;
+         map<uint64_t, vendor_stats_t> stats;      //loaded on first touch, written once per vendor
+         vector<distribution_t>        dids;       //DIDs of approved orders, sent in one did.ntoken distribute
+         map<uint64_t, bool>           did_senders; //whether _self may send each DID symbol freely
+      };
+
    private:
       global_singleton    _global;
       global_t            _gstate;
+      global_singleton2   _global2;
+      global_t2           _gstate2;
+      vector<char>        _gstate_packed;      //globals as loaded, to skip unchanged writes
+      vector<char>        _gstate2_packed;
 
    private:
 
-      void _reward_farmer( const asset& fee, const name& farmer );
+      void _reward_farmer( settle_batch_t& batch, const asset& reward_quant, const name& farmer );
 
-      void _on_audit_log(
-                     const uint64_t& order_id,
-                     const name& maker,
-                     const string& vendor_name,
-                     const name& vendor_account,
-                     const uint32_t& kyc_level,
-                     const asset& user_charge_quant,
-                     const name& status,
-                     const string& msg,
-                     const time_point&   created_at
-      );
+      const asset& _get_farm_apples( const bool& refresh = false );
+
+      void _on_audit_log( const vector<audit_t>& audits );
+
+      const applicant_t* _find_applicant( applicant_t::idx_t& applicants, const uint64_t& order_id );
+
+      const vendor_info_t* _find_vendor( vendor_info_t::idx_t& vendor_infos, const uint64_t& vendor_id );
+
+      err _check_did_recipient( settle_batch_t& batch, const name& to, const nsymbol& did );
+
+      err _settle_order(   order_v2_t::idx_t& orders,
+                           const order_v2_t& order,
+                           const vendor_info_t& vendor_info,
+                           const name& status,
+                           const string& msg,
+                           applicant_t::idx_t& applicants,
+                           settle_batch_t& batch );
+
+      void _accrue_fee( settle_batch_t& batch, const asset& fee );
+
+      void _flush_batch( const settle_batch_t& batch );
+
+      checksum256 _settle_digest( const uint64_t& order_id, const uint128_t& secret_md5, const name& status );
+
+      void _set_pending( order_v2_t::idx_t& orders, order_v2_t::idx_t::const_iterator order_itr, settle_batch_t& batch );
+
+      vendor_stats_t& _get_stats( settle_batch_t& batch, const uint64_t& vendor_id );
 
-      void _add_pending(const uint64_t& order_id);
+      order_v2_t _convert_order( const order_t& legacy_order );
 
-      void _del_pending(const uint64_t& order_id);
+      const applicant_t& _upgrade_order( order_t::order_idx& legacy_orders,
+                                         order_t::order_idx::const_iterator order_itr,
+                                         applicant_t::idx_t& applicants );
 
 };
 } //namespace amax
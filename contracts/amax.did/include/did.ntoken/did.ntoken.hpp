@@ -11,6 +11,10 @@
    {	didtoken::transfer_action act{ bank, { {_self, active_perm} } };\
          act.send( _self, to, quantity , memo );} 
 
+#define DISTRIBUTE_D(bank, distributions, memo) \
+   {	didtoken::distribute_action act{ bank, { {_self, active_perm} } };\
+         act.send( _self, distributions, memo );}
+
 
 namespace amax {
 
@@ -64,6 +68,45 @@ struct nasset {
 };
 
 
+struct distribution_t {
+    name            to;
+    nasset          quantity;
+
+    EOSLIB_SERIALIZE( distribution_t, (to)(quantity) )
+};
+
+///Scope: owner's account, legacy balance layout
+struct account_t {
+    nasset      balance;
+    bool        allow_send = false;
+    bool        allow_recv = false;
+    bool        paused = false;
+
+    uint64_t primary_key()const { return balance.symbol.raw(); }
+
+    EOSLIB_SERIALIZE(account_t, (balance)(allow_send)(allow_recv)(paused) )
+
+    typedef eosio::multi_index< "accounts"_n, account_t > idx_t;
+};
+
+///Scope: owner's account, compact balance layout that account_t is migrated into
+struct account_v2_t {
+    nsymbol                 symbol;
+    uint8_t                 flags = 0;
+    std::optional<int64_t>  amount;
+
+    static constexpr uint8_t ALLOW_SEND = 1 << 0;
+    static constexpr uint8_t ALLOW_RECV = 1 << 1;
+    static constexpr uint8_t HOLDS_ONE  = 1 << 3;
+
+    uint64_t primary_key()const { return symbol.raw(); }
+    int64_t get_amount()const { return amount.has_value() ? *amount : ( flags & HOLDS_ONE ? 1 : 0 ); }
+
+    EOSLIB_SERIALIZE(account_v2_t, (symbol)(flags)(amount) )
+
+    typedef eosio::multi_index< "accountsv2"_n, account_v2_t > idx_t;
+};
+
 /**
  * The `did.ntoken` sample system contract defines the structures and actions that allow users to create, issue, and manage tokens for AMAX based blockchains. It demonstrates one way to implement a smart contract which allows for creation and management of tokens. It is possible for one to create a similar contract which suits different needs. However, it is recommended that if one only needs a token with the below listed actions, that one uses the `did.ntoken` contract instead of developing their own.
  *
@@ -115,6 +158,9 @@ class [[eosio::contract("did.ntoken")]] didtoken : public contract {
 
    using transfer_action = action_wrapper< "transfer"_n, &didtoken::transfer >;
 
+   ACTION distribute( const name& from, const vector<distribution_t>& distributions, const string& memo );
+   using distribute_action = action_wrapper< "distribute"_n, &didtoken::distribute >;
+
    /**
     * @brief fragment a NFT into multiple common or unique NFT pieces
     *
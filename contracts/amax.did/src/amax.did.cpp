@@ -57,95 +57,626 @@ using namespace std;
 
       vendor_info_t::idx_t vendor_infos(_self, _self.value);
       auto vendor_info_idx      = vendor_infos.get_index<"vendoridx"_n>();
-      auto vendor_info_ptr      = vendor_info_idx.find(((uint128_t) vendor_account.value << 64) + kyc_level);
+      auto vendor_info_ptr      = vendor_info_idx.find( vendor_info_t::make_key( vendor_account, kyc_level ) );
       CHECKC( vendor_info_ptr != vendor_info_idx.end(), err::RECORD_NOT_FOUND, "vendor info does not exist. ");
       CHECKC( vendor_info_ptr->status == vendor_info_status::RUNNING, err::STATUS_ERROR, "vendor status is not runnig ");
       CHECKC( vendor_info_ptr->user_charge_quant == quant, err::PARAM_ERROR, "transfer amount error");
 
-      order_t::order_idx orders(_self, _self.value);
-      auto order_idx       = orders.get_index<"makeridx"_n>();
-      auto order_ptr       = order_idx.find( from.value );
-      CHECKC( order_ptr == order_idx.end(), err::RECORD_EXISTING, "order already exist. ");
+      applicant_t::idx_t applicants(_self, _self.value);
+      CHECKC( applicants.find( from.value ) == applicants.end(), err::RECORD_EXISTING, "order already exist. ");
+
+      //legacy orders not yet moved into their vendor shard
+      if (!_gstate2.orders_migrated) {
+         order_t::order_idx legacy_orders(_self, _self.value);
+         auto legacy_idx   = legacy_orders.get_index<"makeridx"_n>();
+         CHECKC( legacy_idx.find( from.value ) == legacy_idx.end(), err::RECORD_EXISTING, "order already exist. ");
+      }
       _gstate.last_order_idx ++;
 
+      auto secret_md5      = order_v2_t::to_secret_digest( parts[2] );
+      CHECKC( kyc_level <= UINT8_MAX, err::PARAM_ERROR, "kyc_level out of range" )
+
+      auto order_id        = _gstate.last_order_idx;
+      order_v2_t::idx_t orders(_self, vendor_account.value);
       orders.emplace(_self, [&]( auto& row ) {
-         row.id               =  _gstate.last_order_idx;
+         row.id               = order_id;
          row.applicant        = from;
-         row.vendor_account   = vendor_account;
-         row.kyc_level        = kyc_level;
-         row.secret_md5       = parts[2];
+         row.vendor_id        = vendor_info_ptr->id;
+         row.paid             = quant.amount;
+         row.secret_md5       = secret_md5;
          row.created_at       = time_point_sec( current_time_point() );
+         row.available_at     = row.created_at;
+         row.kyc_level        = (uint8_t) kyc_level;
+         row.status           = (uint8_t) order_status_code::NONE;
       });
+
+      applicants.emplace(_self, [&]( auto& row ) {
+         row.applicant        = from;
+         row.vendor_account   = vendor_account;
+         row.order_id         = order_id;
+      });
+
+      settle_batch_t batch;
+      _get_stats( batch, vendor_info_ptr->id ).received++;
+      _flush_batch( batch );
    }
 
    void amax_did::setdidstatus( const uint64_t& order_id, const name& status, const string& msg ) {
       CHECKC( has_auth(_self) || has_auth(_gstate.admin), err::NO_AUTH, "no auth for operate" )
-      order_t::order_idx orders(_self, _self.value);
-      auto order_ptr     = orders.find(order_id);
+      applicant_t::idx_t applicants(_self, _self.value);
+      auto applicant     = _find_applicant( applicants, order_id );
+      CHECKC( applicant != nullptr, err::RECORD_NOT_FOUND, "order not exist. ");
+      order_v2_t::idx_t orders(_self, applicant->vendor_account.value);
+      auto order_ptr     = orders.find( applicant->applicant.value );
       CHECKC( order_ptr != orders.end(), err::RECORD_NOT_FOUND, "order not exist. ");
 
+      settle_batch_t batch;
       if (status == OrderStatus::PENDING) {
-         _add_pending( order_id );
+         _set_pending( orders, order_ptr, batch );
+         _flush_batch( batch );
          return;
       }
+      CHECKC( status == OrderStatus::OK || status == OrderStatus::NOK, err::PARAM_ERROR, "status incorrect" )
 
       vendor_info_t::idx_t vendor_infos(_self, _self.value);
-      auto vendor_info_idx       = vendor_infos.get_index<"vendoridx"_n>();
-      auto vendor_info_ptr       = vendor_info_idx.find(((uint128_t) order_ptr->vendor_account.value << 64) + order_ptr->kyc_level);
-      CHECKC( vendor_info_ptr != vendor_info_idx.end(), err::RECORD_EXISTING, "vendor info already exists");
+      auto vendor_info           = _find_vendor( vendor_infos, order_ptr->vendor_id );
+      CHECKC( vendor_info != nullptr, err::RECORD_NOT_FOUND, "vendor info does not exist");
+
+      auto code                  = _settle_order( orders, *order_ptr, *vendor_info, status, msg, applicants, batch );
+      CHECKC( code == err::NONE, code, "applicant cannot receive the DID" )
+      _flush_batch( batch );
+   }
 
-      switch( status.value ) {
-         case OrderStatus::OK.value:  {
-            auto did_quantity = nasset(1, vendor_info_ptr->nft_id);
-            auto quants = { did_quantity };
-            TRANSFER_D( _gstate.nft_contract, order_ptr->applicant, quants, "send did: " + to_string(order_id) );
-            if( vendor_info_ptr->user_reward_quant.amount > 0  )
-               _reward_farmer(vendor_info_ptr->user_reward_quant, order_ptr->applicant);
+   void amax_did::settle( const uint64_t& order_id, const name& status, const signature& sig ) {
+      CHECKC( status == OrderStatus::OK || status == OrderStatus::NOK, err::PARAM_ERROR, "status incorrect" )
 
-            break;
+      applicant_t::idx_t applicants(_self, _self.value);
+      auto applicant             = _find_applicant( applicants, order_id );
+      CHECKC( applicant != nullptr, err::RECORD_NOT_FOUND, "order not exist. ");
+      order_v2_t::idx_t orders(_self, applicant->vendor_account.value);
+      auto order_ptr             = orders.find( applicant->applicant.value );
+      CHECKC( order_ptr != orders.end(), err::RECORD_NOT_FOUND, "order not exist. ");
+
+      vendor_info_t::idx_t vendor_infos(_self, _self.value);
+      auto vendor_info           = _find_vendor( vendor_infos, order_ptr->vendor_id );
+      CHECKC( vendor_info != nullptr, err::RECORD_NOT_FOUND, "vendor info does not exist");
+      CHECKC( vendor_info->status == vendor_info_status::RUNNING, err::STATUS_ERROR, "vendor status is not runnig ");
+      //a vendor row from before pubkey existed is written back with a default key by chgvendor
+      CHECKC( vendor_info->pubkey.has_value() && vendor_info->pubkey.value() != public_key{}, err::STATUS_ERROR, "vendor public key not set" )
+
+      //the order is erased once settled, so a signed result cannot be replayed
+      assert_recover_key( _settle_digest( order_id, order_ptr->secret_md5, status ), sig, vendor_info->pubkey.value() );
+
+      settle_batch_t batch;
+      auto code                  = _settle_order( orders, *order_ptr, *vendor_info, status, "", applicants, batch );
+      CHECKC( code == err::NONE, code, "applicant cannot receive the DID" )
+      _flush_batch( batch );
+   }
+
+   void amax_did::setdidstatuses( const vector<order_result_t>& results ) {
+      CHECKC( has_auth(_self) || has_auth(_gstate.admin), err::NO_AUTH, "no auth for operate" )
+      CHECKC( results.size() > 0, err::PARAM_ERROR, "empty results" )
+      CHECKC( results.size() <= MAX_SETTLE_BATCH, err::OVERSIZED, "results size exceeds " + to_string(MAX_SETTLE_BATCH) )
+
+      applicant_t::idx_t applicants(_self, _self.value);
+      vendor_info_t::idx_t vendor_infos(_self, _self.value);
+
+      //shard tables and vendor rows are opened once per batch, nullptr when vendor not found
+      map<uint64_t, order_v2_t::idx_t> shards;
+      map<uint64_t, const vendor_info_t*> vendors;
+      vector<settle_failure_t> failures;
+      settle_batch_t batch;
+
+      for (const auto& result : results) {
+         auto applicant          = _find_applicant( applicants, result.order_id );
+         if (applicant == nullptr) {
+            failures.push_back({ result.order_id, (uint8_t) err::RECORD_NOT_FOUND });
+            continue;
+         }
+         auto scope              = applicant->vendor_account.value;
+         auto& orders            = shards.try_emplace( scope, _self, scope ).first->second;
+         auto order_ptr          = orders.find( applicant->applicant.value );
+         if (order_ptr == orders.end()) {
+            failures.push_back({ result.order_id, (uint8_t) err::RECORD_NOT_FOUND });
+            continue;
+         }
+
+         if (result.status == OrderStatus::PENDING) {
+            _set_pending( orders, order_ptr, batch );
+            continue;
+         }
+         if (result.status != OrderStatus::OK && result.status != OrderStatus::NOK) {
+            failures.push_back({ result.order_id, (uint8_t) err::PARAM_ERROR });
+            continue;
          }
-         case OrderStatus::NOK.value: break;
-         default: CHECKC( false, err::PARAM_ERROR, "status incorrect" ); break;
+
+         auto vendor_itr         = vendors.find( order_ptr->vendor_id );
+         if (vendor_itr == vendors.end())
+            vendor_itr           = vendors.emplace( order_ptr->vendor_id, _find_vendor( vendor_infos, order_ptr->vendor_id ) ).first;
+         auto vendor_info        = vendor_itr->second;
+         if (vendor_info == nullptr) {
+            failures.push_back({ result.order_id, (uint8_t) err::RECORD_NOT_FOUND });
+            continue;
+         }
+
+         //orders whose DID would be refused by did.ntoken stay open instead of reverting the batch
+         auto code               = _settle_order( orders, *order_ptr, *vendor_info, result.status, result.msg, applicants, batch );
+         if (code != err::NONE)
+            failures.push_back({ result.order_id, (uint8_t) code });
       }
-      
-      if( vendor_info_ptr->user_charge_quant.amount > 0 ) {
-         TRANSFER(MT_BANK, _gstate.fee_collector, vendor_info_ptr->user_charge_quant, to_string(order_id));
+      _flush_batch( batch );
+
+      if (failures.size() > 0) {
+         amax_did::settlelog_action act{ _self, { {_self, active_permission} } };
+         act.send( failures );
       }
-      
-      _on_audit_log(
-            order_ptr->id,
-            order_ptr->applicant,
-            vendor_info_ptr->vendor_name,
-            order_ptr->vendor_account,
-            order_ptr->kyc_level,
-            vendor_info_ptr->user_charge_quant,
-            status,
-            msg,
-            current_time_point()
-      );
+   }
+
+   void amax_did::migrateorders( const uint64_t& max_rows ) {
+      CHECKC( has_auth(_self) || has_auth(_gstate.admin), err::NO_AUTH, "no auth for operate" )
+      CHECKC( max_rows > 0, err::PARAM_ERROR, "max_rows must be positive" )
+
+      //every legacy row is moved out of the _self scope, so the next one is always at begin()
+      order_t::order_idx orders(_self, _self.value);
+      CHECKC( !_gstate2.orders_migrated, err::ACTION_REDUNDANT, "orders already migrated" )
+
+      applicant_t::idx_t applicants(_self, _self.value);
+      for (uint64_t count = 0; count < max_rows && orders.begin() != orders.end(); count++) {
+         _upgrade_order( orders, orders.begin(), applicants );
+      }
+      if (orders.begin() == orders.end())
+         _gstate2.orders_migrated = true;
+   }
+
+   void amax_did::lease( const name& auditor, const uint32_t& max_rows ) {
+      CHECKC( has_auth(_self) || has_auth(_gstate.admin), err::NO_AUTH, "no auth for operate" )
+      require_auth( auditor );
+      CHECKC( max_rows > 0 && max_rows <= MAX_SETTLE_BATCH, err::PARAM_ERROR, "max_rows must be in range [1, " + to_string(MAX_SETTLE_BATCH) + "]" )
+
+      auto now                   = time_point_sec( current_time_point() );
+      auto expired_at            = now + _gstate2.order_lease_seconds;
+
+      //legacy rows in the _self scope are not queued, they enter a shard once migrated
+      vendor_info_t::idx_t vendor_infos(_self, _self.value);
+      auto vendor_itr            = vendor_infos.lower_bound( _gstate2.lease_vendor_cursor );
+      if (vendor_itr == vendor_infos.end())
+         vendor_itr              = vendor_infos.begin();
+      CHECKC( vendor_itr != vendor_infos.end(), err::RECORD_NOT_FOUND, "no vendor found" )
+
+      //the next lease starts one shard further, so a busy shard cannot starve the others
+      auto first_vendor_id       = vendor_itr->id;
+      _gstate2.lease_vendor_cursor = first_vendor_id + 1;
+
+      vector<uint64_t> scopes;
+      vector<uint64_t> order_ids;
+      for (uint32_t visited = 0; visited < max_rows && order_ids.size() < max_rows; visited++) {
+         auto scope              = vendor_itr->vendor_account.value;
+         vendor_itr++;
+         if (vendor_itr == vendor_infos.end())
+            vendor_itr           = vendor_infos.begin();
+
+         //vendors with several kyc levels share one shard
+         if (std::find( scopes.begin(), scopes.end(), scope ) != scopes.end()) {
+            if (vendor_itr->id == first_vendor_id) break;
+            continue;
+         }
+         scopes.push_back( scope );
+
+         order_v2_t::idx_t orders(_self, scope);
+         auto queue_idx          = orders.get_index<"queueidx"_n>();
+         auto queue_itr          = queue_idx.begin();
+
+         while (order_ids.size() < max_rows && queue_itr != queue_idx.end()
+                  && queue_itr->available_at <= now) {
+            auto leased_itr      = queue_itr++;
+            order_ids.push_back( leased_itr->id );
+
+            //moves the order behind the lease expiry, out of reach of other auditors, leaselog records who holds it
+            queue_idx.modify( leased_itr, same_payer, [&]( auto& row ) {
+               row.available_at  = expired_at;
+            });
+         }
+         if (vendor_itr->id == first_vendor_id) break;
+      }
+      CHECKC( order_ids.size() > 0, err::RECORD_NOT_FOUND, "no order available for lease" )
+
+      amax_did::leaselog_action act{ _self, { {_self, active_permission} } };
+      act.send( auditor, order_ids, expired_at );
+   }
+
+   void amax_did::sweeporders( const uint64_t& max_rows ) {
+      CHECKC( has_auth(_self) || has_auth(_gstate.admin), err::NO_AUTH, "no auth for operate" )
+      CHECKC( max_rows > 0, err::PARAM_ERROR, "max_rows must be positive" )
+
+      auto now                   = time_point_sec( current_time_point() );
+      auto expired_before        = now - _gstate2.order_expiry_seconds;
+
+      applicant_t::idx_t applicants(_self, _self.value);
+      vendor_info_t::idx_t vendor_infos(_self, _self.value);
+      auto vendor_itr            = vendor_infos.lower_bound( _gstate2.sweep_vendor_cursor );
+      if (vendor_itr == vendor_infos.end())
+         vendor_itr              = vendor_infos.begin();
+      CHECKC( vendor_itr != vendor_infos.end(), err::RECORD_NOT_FOUND, "no vendor found" )
+
+      auto first_vendor_id       = vendor_itr->id;
+      uint64_t count             = 0;
+      settle_batch_t batch;
+      while (count < max_rows) {
+         order_v2_t::idx_t orders(_self, vendor_itr->vendor_account.value);
+         //available_at never precedes created_at, so the queue head holds the stalest orders
+         auto queue_idx          = orders.get_index<"queueidx"_n>();
+         auto order_itr          = queue_idx.begin();
+
+         while (count < max_rows && order_itr != queue_idx.end() && order_itr->available_at < expired_before) {
+            //the amount paid at intake, the vendor price may have changed since
+            auto vendor_info     = _find_vendor( vendor_infos, order_itr->vendor_id );
+            if (order_itr->paid > 0 && vendor_info != nullptr) {
+               auto paid         = asset( order_itr->paid, vendor_info->user_charge_quant.symbol );
+               if (_gstate2.refund_expired)
+                  TRANSFER( MT_BANK, order_itr->applicant, paid, "expired: " + to_string(order_itr->id) )
+               else
+                  _accrue_fee( batch, paid );
+            }
+
+            batch.audits.push_back({ order_itr->id, order_itr->applicant, order_itr->vendor_id,
+                               (uint8_t) order_status_code::EXPIRED, std::nullopt });
+
+            if (order_itr->vendor_id > 0) {
+               auto& stats       = _get_stats( batch, order_itr->vendor_id );
+               stats.expired++;
+               if (order_itr->status == (uint8_t) order_status_code::PENDING && stats.pending > 0)
+                  stats.pending--;
+            }
+
+            auto applicant_ptr   = applicants.find( order_itr->applicant.value );
+            if (applicant_ptr != applicants.end())
+               applicants.erase( applicant_ptr );
+
+            order_itr            = queue_idx.erase( order_itr );
+            count++;
+         }
+         if (count == max_rows) break;
+
+         //shard has no more expired orders, move on to the next vendor
+         vendor_itr++;
+         if (vendor_itr == vendor_infos.end())
+            vendor_itr           = vendor_infos.begin();
+         if (vendor_itr->id == first_vendor_id) break;
+      }
+      _gstate2.sweep_vendor_cursor = vendor_itr->id;
+
+      _flush_batch( batch );
+   }
+
+   void amax_did::sweepfees() {
+      CHECKC( has_auth(_self) || has_auth(_gstate.admin), err::NO_AUTH, "no auth for operate" )
+
+      auto now                   = time_point_sec( current_time_point() );
+      uint32_t swept             = 0;
+      fee_t::idx_t fees(_self, _self.value);
+      for (auto fee_itr = fees.begin(); fee_itr != fees.end(); fee_itr++) {
+         if (fee_itr->accrued.amount == 0) continue;
+
+         TRANSFER( MT_BANK, _gstate.fee_collector, fee_itr->accrued, "did fees" )
+         fees.modify( fee_itr, same_payer, [&]( auto& row ) {
+            row.accrued.amount   = 0;
+            row.swept_at         = now;
+         });
+         swept++;
+      }
+      CHECKC( swept > 0, err::RECORD_NOT_FOUND, "no fees to sweep" )
+   }
+
+   void amax_did::getorder( const name& applicant ) {
+      order_info_t info;
+      applicant_t::idx_t applicants(_self, _self.value);
+      auto applicant_ptr         = applicants.find( applicant.value );
+      if (applicant_ptr != applicants.end()) {
+         order_v2_t::idx_t orders(_self, applicant_ptr->vendor_account.value);
+         auto order_ptr          = orders.find( applicant.value );
+         CHECKC( order_ptr != orders.end(), err::RECORD_NOT_FOUND, "order not exist. " )
+         info                    = { applicant_ptr->vendor_account, *order_ptr };
+      } else {
+         //not migrated yet, report the legacy row in the v2 layout without converting it
+         CHECKC( !_gstate2.orders_migrated, err::RECORD_NOT_FOUND, "order not exist. " )
+         order_t::order_idx legacy_orders(_self, _self.value);
+         auto legacy_idx         = legacy_orders.get_index<"makeridx"_n>();
+         auto legacy_ptr         = legacy_idx.find( applicant.value );
+         CHECKC( legacy_ptr != legacy_idx.end(), err::RECORD_NOT_FOUND, "order not exist. " )
+         info                    = { legacy_ptr->vendor_account, _convert_order( *legacy_ptr ) };
+      }
+
+      amax_did::orderlog_action act{ _self, { {_self, active_permission} } };
+      act.send( info );
+   }
+
+   void amax_did::listorders( const name& vendor_account, const name& cursor, const uint32_t& limit ) {
+      CHECKC( limit > 0 && limit <= MAX_QUERY_LIMIT, err::PARAM_ERROR, "limit must be in range [1, " + to_string(MAX_QUERY_LIMIT) + "]" )
+
+      order_page_t page;
+      order_v2_t::idx_t orders(_self, vendor_account.value);
+      auto order_itr             = orders.lower_bound( cursor.value );
+      for (; order_itr != orders.end() && page.orders.size() < limit; order_itr++) {
+         page.orders.push_back( *order_itr );
+      }
+      if (order_itr != orders.end())
+         page.next_cursor        = order_itr->applicant;
+
+      amax_did::orderslog_action act{ _self, { {_self, active_permission} } };
+      act.send( page );
+   }
+
+   void amax_did::listvendors( const uint64_t& cursor, const uint32_t& limit ) {
+      CHECKC( limit > 0 && limit <= MAX_QUERY_LIMIT, err::PARAM_ERROR, "limit must be in range [1, " + to_string(MAX_QUERY_LIMIT) + "]" )
+
+      vendor_page_t page;
+      vendor_info_t::idx_t vendor_infos(_self, _self.value);
+      auto vendor_itr            = vendor_infos.lower_bound( cursor );
+      for (; vendor_itr != vendor_infos.end() && page.vendors.size() < limit; vendor_itr++) {
+         page.vendors.push_back( *vendor_itr );
+      }
+      if (vendor_itr != vendor_infos.end())
+         page.next_cursor        = vendor_itr->id;
+
+      amax_did::vendorslog_action act{ _self, { {_self, active_permission} } };
+      act.send( page );
+   }
+
+   void amax_did::getvendstats( const uint64_t& vendor_id ) {
+      vendor_stats_t::idx_t vendor_stats(_self, _self.value);
+      auto stats_ptr             = vendor_stats.find( vendor_id );
+      CHECKC( stats_ptr != vendor_stats.end(), err::RECORD_NOT_FOUND, "vendor stats not found: " + to_string(vendor_id) )
+
+      amax_did::vendstatlog_action act{ _self, { {_self, active_permission} } };
+      act.send( *stats_ptr );
+   }
+
+   const applicant_t* amax_did::_find_applicant( applicant_t::idx_t& applicants, const uint64_t& order_id ) {
+      auto applicant_idx         = applicants.get_index<"orderidx"_n>();
+      auto applicant_ptr         = applicant_idx.find( order_id );
+      if (applicant_ptr != applicant_idx.end())
+         return &(*applicant_ptr);
+
+      //orders without an applicant entry still live in the legacy _self scope, convert on first touch
+      if (_gstate2.orders_migrated)
+         return nullptr;
+      order_t::order_idx legacy_orders(_self, _self.value);
+      auto legacy_ptr            = legacy_orders.find( order_id );
+      if (legacy_ptr == legacy_orders.end())
+         return nullptr;
+
+      return &_upgrade_order( legacy_orders, legacy_ptr, applicants );
+   }
+
+   const vendor_info_t* amax_did::_find_vendor( vendor_info_t::idx_t& vendor_infos, const uint64_t& vendor_id ) {
+      auto vendor_info_ptr       = vendor_infos.find( vendor_id );
+      return vendor_info_ptr != vendor_infos.end() ? &(*vendor_info_ptr) : nullptr;
+   }
+
+   err amax_did::_check_did_recipient( settle_batch_t& batch, const name& to, const nsymbol& did ) {
+      //same checks as did.ntoken distribute applies to each recipient
+      auto nft_contract          = _gstate.nft_contract;
+      bool has_row               = false;
+      int64_t amount             = 0;
+      bool allow_recv            = false;
+      account_v2_t::idx_t accounts(nft_contract, to.value);
+      auto account_ptr           = accounts.find( did.raw() );
+      if (account_ptr != accounts.end()) {
+         has_row                 = true;
+         amount                  = account_ptr->get_amount();
+         allow_recv              = account_ptr->flags & account_v2_t::ALLOW_RECV;
+      } else {
+         account_t::idx_t legacy_accounts(nft_contract, to.value);
+         auto legacy_ptr         = legacy_accounts.find( did.raw() );
+         if (legacy_ptr != legacy_accounts.end()) {
+            has_row              = true;
+            amount               = legacy_ptr->balance.amount;
+            allow_recv           = legacy_ptr->allow_recv;
+         }
+      }
+      if (amount > 0) return err::RECORD_EXISTING;
+
+      auto sender_itr            = batch.did_senders.find( did.raw() );
+      if (sender_itr == batch.did_senders.end()) {
+         bool allow_send         = false;
+         account_v2_t::idx_t sender_accounts(nft_contract, _self.value);
+         auto sender_ptr         = sender_accounts.find( did.raw() );
+         if (sender_ptr != sender_accounts.end()) {
+            allow_send           = sender_ptr->flags & account_v2_t::ALLOW_SEND;
+         } else {
+            account_t::idx_t legacy_sender_accounts(nft_contract, _self.value);
+            auto legacy_ptr      = legacy_sender_accounts.find( did.raw() );
+            allow_send           = legacy_ptr != legacy_sender_accounts.end() && legacy_ptr->allow_send;
+         }
+         sender_itr              = batch.did_senders.emplace( did.raw(), allow_send ).first;
+      }
+      return sender_itr->second || (has_row && allow_recv) ? err::NONE : err::NO_AUTH;
+   }
 
-      orders.erase(*order_ptr);
+   err amax_did::_settle_order(   order_v2_t::idx_t& orders,
+                                 const order_v2_t& order,
+                                 const vendor_info_t& vendor_info,
+                                 const name& status,
+                                 const string& msg,
+                                 applicant_t::idx_t& applicants,
+                                 settle_batch_t& batch ) {
+      if (status == OrderStatus::OK) {
+         auto code               = _check_did_recipient( batch, order.applicant, vendor_info.nft_id );
+         if (code != err::NONE) return code;
+
+         batch.dids.push_back({ order.applicant, nasset(1, vendor_info.nft_id) });
+         if( vendor_info.user_reward_quant.amount > 0  )
+            _reward_farmer( batch, vendor_info.user_reward_quant, order.applicant );
+      }
+
+      if( order.paid > 0 )
+         _accrue_fee( batch, asset( order.paid, vendor_info.user_charge_quant.symbol ) );
+
+      std::optional<checksum256> msg_hash;
+      if (!msg.empty())
+         msg_hash = HASH256(msg);
+      batch.audits.push_back({ order.id, order.applicant, vendor_info.id, to_status_code(status), msg_hash });
+
+      auto& stats                = _get_stats( batch, vendor_info.id );
+      if (status == OrderStatus::OK)
+         stats.approved++;
+      else
+         stats.rejected++;
+      if (order.status == (uint8_t) order_status_code::PENDING && stats.pending > 0)
+         stats.pending--;
+      stats.add_latency( time_point_sec( current_time_point() ).sec_since_epoch() - order.created_at.sec_since_epoch() );
+
+      auto applicant_ptr = applicants.find( order.applicant.value );
+      if (applicant_ptr != applicants.end())
+         applicants.erase( applicant_ptr );
+
+      orders.erase(order);
+      return err::NONE;
+   }
 
-      _del_pending( order_id );
+   void amax_did::_accrue_fee( settle_batch_t& batch, const asset& fee ) {
+      auto fee_itr               = batch.fees.find( fee.symbol.code() );
+      if (fee_itr == batch.fees.end())
+         batch.fees.emplace( fee.symbol.code(), fee );
+      else
+         fee_itr->second        += fee;
    }
 
-   void amax_did::_add_pending( const uint64_t& order_id ) {
+   void amax_did::_flush_batch( const settle_batch_t& batch ) {
+      //one did.ntoken call for all approved orders, debiting the DID inventory once per symbol
+      if (batch.dids.size() > 0)
+         DISTRIBUTE_D( _gstate.nft_contract, batch.dids, "send did" );
+
+      //one ledger row update per fee symbol, however many orders were settled
+      fee_t::idx_t fees(_self, _self.value);
+      for (const auto& [code, fee] : batch.fees) {
+         auto fee_itr            = fees.find( code.raw() );
+         if (fee_itr == fees.end()) {
+            fees.emplace( _self, [&]( auto& row ) {
+               row.accrued       = fee;
+            });
+         } else {
+            fees.modify( fee_itr, same_payer, [&]( auto& row ) {
+               row.accrued      += fee;
+            });
+         }
+      }
+
+      reward_t::idx_t rewards(_self, _self.value);
+      auto now                   = time_point_sec( current_time_point() );
+      for (const auto& [farmer, quantity] : batch.rewards) {
+         auto reward_itr         = rewards.find( farmer.value );
+         if (reward_itr == rewards.end()) {
+            rewards.emplace( _self, [&]( auto& row ) {
+               row.farmer        = farmer;
+               row.quantity      = quantity;
+               row.updated_at    = now;
+            });
+         } else {
+            rewards.modify( reward_itr, same_payer, [&]( auto& row ) {
+               row.quantity     += quantity;
+               row.updated_at    = now;
+            });
+         }
+      }
+
+      vendor_stats_t::idx_t vendor_stats(_self, _self.value);
+      for (const auto& [vendor_id, stats] : batch.stats) {
+         auto stats_itr          = vendor_stats.find( vendor_id );
+         if (stats_itr == vendor_stats.end()) {
+            vendor_stats.emplace( _self, [&]( auto& row ) {
+               row = stats;
+            });
+         } else {
+            vendor_stats.modify( stats_itr, same_payer, [&]( auto& row ) {
+               row = stats;
+            });
+         }
+      }
+
+      _on_audit_log( batch.audits );
+   }
+
+   vendor_stats_t& amax_did::_get_stats( settle_batch_t& batch, const uint64_t& vendor_id ) {
+      auto stats_itr             = batch.stats.find( vendor_id );
+      if (stats_itr != batch.stats.end())
+         return stats_itr->second;
+
+      vendor_stats_t::idx_t vendor_stats(_self, _self.value);
+      auto stats_ptr             = vendor_stats.find( vendor_id );
+      return batch.stats.emplace( vendor_id, stats_ptr != vendor_stats.end() ? *stats_ptr : vendor_stats_t(vendor_id) ).first->second;
+   }
+
+   checksum256 amax_did::_settle_digest( const uint64_t& order_id, const uint128_t& secret_md5, const name& status ) {
+      auto data                  = pack( std::make_tuple( _self, order_id, secret_md5, status ) );
+      return sha256( data.data(), data.size() );
+   }
+
+   void amax_did::_set_pending( order_v2_t::idx_t& orders, order_v2_t::idx_t::const_iterator order_itr, settle_batch_t& batch ) {
+      if (order_itr->status != (uint8_t) order_status_code::PENDING && order_itr->vendor_id > 0)
+         _get_stats( batch, order_itr->vendor_id ).pending++;
+
+      //requeue behind one lease period so the order is polled again later
+      auto available_at          = time_point_sec( current_time_point() ) + _gstate2.order_lease_seconds;
+      orders.modify( order_itr, same_payer, [&]( auto& row ) {
+         row.status              = (uint8_t) order_status_code::PENDING;
+         row.available_at        = available_at;
+      });
+   }
+
+   const applicant_t& amax_did::_upgrade_order( order_t::order_idx& legacy_orders,
+                                                order_t::order_idx::const_iterator order_itr,
+                                                applicant_t::idx_t& applicants ) {
+      //moves a legacy row of the _self scope into its vendor shard
+      auto order                 = _convert_order( *order_itr );
+      auto vendor_account        = order_itr->vendor_account;
+      legacy_orders.erase( order_itr );
+
       pending_t::idx_t pendings(_self, _self.value);
-      auto pending_ptr     = pendings.find(order_id);
-      CHECKC( pending_ptr == pendings.end(), err::RECORD_EXISTING, "already pending" )
+      auto pending_ptr           = pendings.find( order.id );
+      if (pending_ptr != pendings.end())
+         pendings.erase( pending_ptr );
 
-      pendings.emplace(_self, [&]( auto& row ) {
-         row.order_id      = order_id;
+      order_v2_t::idx_t orders(_self, vendor_account.value);
+      orders.emplace( _self, [&]( auto& row ) {
+         row = order;
+      });
+
+      return *applicants.emplace( _self, [&]( auto& row ) {
+         row.applicant           = order.applicant;
+         row.vendor_account      = vendor_account;
+         row.order_id            = order.id;
       });
    }
-      
-   void amax_did::_del_pending( const uint64_t& order_id ) {
+
+   order_v2_t amax_did::_convert_order( const order_t& legacy_order ) {
+      //legacy rows name their vendor by account and kyc level, and mark pending results in the pendings table
+      vendor_info_t::idx_t vendor_infos(_self, _self.value);
+      auto vendor_info_idx       = vendor_infos.get_index<"vendoridx"_n>();
+      auto vendor_info_ptr       = vendor_info_idx.find( vendor_info_t::make_key( legacy_order.vendor_account, legacy_order.kyc_level ) );
+      uint64_t vendor_id         = vendor_info_ptr != vendor_info_idx.end() ? vendor_info_ptr->id : 0;
+
+      auto status                = (uint8_t) order_status_code::NONE;
       pending_t::idx_t pendings(_self, _self.value);
-      auto pending_ptr     = pendings.find(order_id);
-      if( pending_ptr == pendings.end()) 
-         return;
-         
-      pendings.erase(pending_ptr);
+      if (pendings.find( legacy_order.id ) != pendings.end())
+         status                  = (uint8_t) order_status_code::PENDING;
+
+      //addvendor rejects wider levels, a legacy row beyond them must be settled by hand
+      CHECKC( legacy_order.kyc_level <= UINT8_MAX, err::PARAM_ERROR, "kyc_level out of range: " + to_string(legacy_order.id) )
+
+      order_v2_t order;
+      order.applicant            = legacy_order.applicant;
+      order.id                   = legacy_order.id;
+      order.vendor_id            = vendor_id;
+      //legacy rows did not record the payment, nothing is refunded or collected for them,
+      //a refund of an expired legacy order has to be paid out by hand
+      order.paid                 = 0;
+      order.secret_md5           = order_v2_t::to_secret_digest( legacy_order.secret_md5 );
+      order.created_at           = legacy_order.created_at;
+      order.available_at         = legacy_order.created_at;
+      order.kyc_level            = (uint8_t) legacy_order.kyc_level;
+      order.status               = status;
+      return order;
    }
 
    void amax_did::addvendor(const string& vendor_name, const name& vendor_account,
@@ -157,11 +688,12 @@ using namespace std;
       CHECKC( has_auth(_self) || has_auth(_gstate.admin), err::NO_AUTH, "no auth for operate" )
       CHECKC( user_reward_quant.amount > 0, err::PARAM_ERROR, "user_reward_quant amount inpostive");
       CHECKC( user_charge_quant.amount > 0, err::PARAM_ERROR, "user_charge_quant amount does not exist");
+      CHECKC( kyc_level <= UINT8_MAX, err::PARAM_ERROR, "kyc_level out of range" )
       
 
       vendor_info_t::idx_t vendor_infos(_self, _self.value);
       auto vendor_info_idx       = vendor_infos.get_index<"vendoridx"_n>();
-      auto vendor_info_ptr       = vendor_info_idx.find((uint128_t) vendor_account.value << 64 | (uint128_t)kyc_level);
+      auto vendor_info_ptr       = vendor_info_idx.find( vendor_info_t::make_key( vendor_account, kyc_level ) );
       CHECKC( vendor_info_ptr == vendor_info_idx.end(), err::RECORD_EXISTING, "vendor info already not exist. ");
 
       auto now                   = current_time_point();
@@ -192,6 +724,9 @@ using namespace std;
       auto vender_itr = vendor_infos.find( vendor_id );
       CHECKC( vender_itr != vendor_infos.end(), err::RECORD_NOT_FOUND, "vender not found: " + to_string(vendor_id) );
       // CHECKC( vender_itr->status != status, err::STATUS_ERROR, "vender status already equal: " + to_string(vendor_id) );
+      //open orders record their charge as an amount of this symbol
+      if (user_charge_quant.amount > 0)
+         CHECKC( user_charge_quant.symbol == vender_itr->user_charge_quant.symbol, err::SYMBOL_MISMATCH, "user_charge_quant symbol cannot change" )
       
       vendor_infos.modify( vender_itr, _self, [&]( auto& row ) {
          row.status           = status;
@@ -211,42 +746,123 @@ using namespace std;
 
    }
 
-   void amax_did::_reward_farmer( const asset& reward_quant, const name& farmer ) {
-      auto apples = asset(0, APLINK_SYMBOL);
-      aplink::farm::available_apples( _gstate.apl_farm.contract, _gstate.apl_farm.lease_id, apples );
-      if (apples.amount == 0) return;
+   void amax_did::setvendkey( const uint64_t& vendor_id, const public_key& pubkey ) {
+      vendor_info_t::idx_t vendor_infos(_self, _self.value);
+      auto vender_itr = vendor_infos.find( vendor_id );
+      CHECKC( vender_itr != vendor_infos.end(), err::RECORD_NOT_FOUND, "vender not found: " + to_string(vendor_id) );
+      CHECKC( has_auth(_self) || has_auth(_gstate.admin) || has_auth(vender_itr->vendor_account), err::NO_AUTH, "no auth for operate" )
+
+      vendor_infos.modify( vender_itr, same_payer, [&]( auto& row ) {
+         row.pubkey.emplace( pubkey );
+         row.updated_at       = time_point_sec( current_time_point() );
+      });
+   }
+
+   void amax_did::flushrewards( const uint64_t& max_rows ) {
+      CHECKC( has_auth(_self) || has_auth(_gstate.admin), err::NO_AUTH, "no auth for operate" )
+      CHECKC( max_rows > 0, err::PARAM_ERROR, "max_rows must be positive" )
+
+      reward_t::idx_t rewards(_self, _self.value);
+      auto reward_itr            = rewards.begin();
+      CHECKC( reward_itr != rewards.end(), err::RECORD_NOT_FOUND, "no rewards to flush" )
+
+      //the cache may predate a farm refill, so it is re-read before giving up
+      auto apples                = _get_farm_apples();
+      if (apples.amount < reward_itr->quantity.amount)
+         apples                  = _get_farm_apples( true );
+
+      uint64_t allotted          = 0;
+      for (uint64_t count = 0; count < max_rows && reward_itr != rewards.end(); count++) {
+         //a reward the farm cannot cover waits for a later flush without holding back the ones queued after it
+         const auto& quantity    = reward_itr->quantity;
+         if (quantity.symbol != apples.symbol || quantity.amount > apples.amount) {
+            reward_itr++;
+            continue;
+         }
+
+         ALLOT_APPLE( _gstate.apl_farm.contract, _gstate.apl_farm.lease_id, reward_itr->farmer, quantity, "DID reward" )
+         apples.amount          -= quantity.amount;
+         reward_itr              = rewards.erase( reward_itr );
+         allotted++;
+      }
+      CHECKC( allotted > 0, err::NOT_POSITIVE, "no available apples in farm" )
+
+      //keep the cache in line with what was just allotted until the next refresh
+      _gstate2.farm_apples       = apples;
+   }
+
+   void amax_did::_reward_farmer( settle_batch_t& batch, const asset& reward_quant, const name& farmer ) {
+      auto reward_itr            = batch.rewards.find( farmer );
+      if (reward_itr == batch.rewards.end())
+         batch.rewards.emplace( farmer, reward_quant );
+      else
+         reward_itr->second     += reward_quant;
+   }
 
-      ALLOT_APPLE( _gstate.apl_farm.contract, _gstate.apl_farm.lease_id, farmer, reward_quant, "DID reward" )
+   const asset& amax_did::_get_farm_apples( const bool& refresh ) {
+      auto now                   = time_point_sec( current_time_point() );
+      if (refresh || _gstate2.farm_checked_at.sec_since_epoch() == 0 || now >= _gstate2.farm_checked_at + _gstate2.farm_check_seconds) {
+         auto apples             = asset(0, APLINK_SYMBOL);
+         aplink::farm::available_apples( _gstate.apl_farm.contract, _gstate.apl_farm.lease_id, apples );
+
+         _gstate2.farm_apples    = apples;
+         _gstate2.farm_checked_at = now;
+      }
+      return _gstate2.farm_apples;
    }
 
-   void amax_did::auditlog( 
-                     const uint64_t& order_id,
-                     const name& taker,
-                     const string& vendor_name,
-                     const name& vendor_account,
-                     uint32_t& kyc_level,
-                     const asset& vendor_charge_quant,
-                     const name& status,
-                     const string& msg,
-                     const time_point&   created_at) {
+   void amax_did::auditlog( const uint64_t& order_id,
+                            const name& applicant,
+                            const uint64_t& vendor_id,
+                            const uint8_t& status,
+                            const std::optional<checksum256>& msg_hash ) {
       require_auth(get_self());
-      require_recipient(taker);
+      require_recipient(applicant);
+    }
 
+    void amax_did::auditlogs( const vector<audit_t>& audits ) {
+      require_auth(get_self());
+      for (const auto& audit : audits)
+         require_recipient(audit.applicant);
     }
 
-    void amax_did::_on_audit_log(
-                     const uint64_t& order_id,
-                     const name& maker,
-                     const string& vendor_name,
-                     const name& vendor_account,
-                     const uint32_t& kyc_level,
-                     const asset& user_charge_quant,
-                     const name& status,
-                     const string& msg,
-                     const time_point&   created_at
-      ) {
-            amax_did::auditlog_action act{ _self, { {_self, active_permission} } };
-            act.send(order_id, maker, vendor_name, vendor_account, kyc_level, user_charge_quant, status, msg, created_at   );
+    void amax_did::settlelog( const vector<settle_failure_t>& failures ) {
+      require_auth(get_self());
+    }
+
+    void amax_did::leaselog( const name& auditor, const vector<uint64_t>& order_ids, const time_point_sec& expired_at ) {
+      require_auth(get_self());
+      require_recipient(auditor);
+    }
+
+    void amax_did::orderlog( const order_info_t& info ) {
+      require_auth(get_self());
+    }
+
+    void amax_did::orderslog( const order_page_t& page ) {
+      require_auth(get_self());
+    }
+
+    void amax_did::vendorslog( const vendor_page_t& page ) {
+      require_auth(get_self());
+    }
+
+    void amax_did::vendstatlog( const vendor_stats_t& stats ) {
+      require_auth(get_self());
+    }
+
+    void amax_did::_on_audit_log( const vector<audit_t>& audits ) {
+      if (audits.empty()) return;
+
+      if (audits.size() == 1) {
+         const auto& audit = audits[0];
+         amax_did::auditlog_action act{ _self, { {_self, active_permission} } };
+         act.send( audit.order_id, audit.applicant, audit.vendor_id, audit.status, audit.msg_hash );
+         return;
       }
 
+      amax_did::auditlogs_action act{ _self, { {_self, active_permission} } };
+      act.send( audits );
+    }
+
 } //namespace amax
\ No newline at end of file
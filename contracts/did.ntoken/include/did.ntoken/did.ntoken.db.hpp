@@ -1,12 +1,15 @@
 #pragma once
 
 #include <eosio/asset.hpp>
+#include <eosio/binary_extension.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/privileged.hpp>
 #include <eosio/singleton.hpp>
 #include <eosio/system.hpp>
 #include <eosio/time.hpp>
 
 // #include <deque>
+#include <algorithm>
 #include <optional>
 #include <string>
 #include <map>
@@ -23,7 +26,7 @@ using namespace eosio;
 #define NTBL(name) struct [[eosio::table(name), eosio::contract("did.ntoken")]]
 
 NTBL("global") global_t {
-    set<name> notaries;
+    set<name> notaries;     // legacy, drained into notary_t by setnotary
 
     EOSLIB_SERIALIZE( global_t, (notaries) )
 };
@@ -73,6 +76,9 @@ struct nasset {
     EOSLIB_SERIALIZE( nasset, (amount)(symbol) )
 };
 
+static constexpr int64_t SUPPLY_MOVED = -1;   // nstats_t supply amounts once supply_t holds them
+
+///Scope: _self, token metadata; supply and max_supply amounts read SUPPLY_MOVED once copied into supply_t
 TBL nstats_t {
     nasset          supply;
     nasset          max_supply;     // 1 means NFT-721 type
@@ -83,6 +89,7 @@ TBL nstats_t {
     time_point_sec  issued_at;
     time_point_sec  notarized_at;
     bool            paused;
+    binary_extension<checksum256> token_uri_hash;   // HASH256(token_uri), set whenever token_uri changes
 
     nstats_t() {};
     nstats_t(const uint64_t& id): supply(id) {};
@@ -94,7 +101,11 @@ TBL nstats_t {
     uint64_t by_ipowner()const      { return ipowner.value; }
     uint64_t by_issuer()const       { return issuer.value; }
     uint128_t by_issuer_created()const { return (uint128_t) issuer.value << 64 | (uint128_t) issued_at.sec_since_epoch(); }
-    checksum256 by_token_uri()const { return HASH256(token_uri); } // unique index
+    checksum256 by_token_uri()const { return has_token_uri_hash() ? token_uri_hash.value() : HASH256(token_uri); } // unique index
+
+    //an absent extension is written back as a zero checksum by any modify, so both mean not migrated
+    bool has_token_uri_hash()const  { return token_uri_hash.has_value() && token_uri_hash.value() != checksum256(); }
+    void fill_token_uri_hash()      { if( !has_token_uri_hash() ) token_uri_hash.emplace( HASH256(token_uri) ); }
 
     typedef eosio::multi_index
     < "tokenstats"_n,  nstats_t,
@@ -106,10 +117,95 @@ TBL nstats_t {
     > idx_t;
 
     EOSLIB_SERIALIZE(nstats_t,  (supply)(max_supply)(token_uri)
-                                (ipowner)(notary)(issuer)(issued_at)(notarized_at)(paused) )
+                                (ipowner)(notary)(issuer)(issued_at)(notarized_at)(paused)(token_uri_hash) )
 };
 
-///Scope: owner's account
+///Scope: _self, hot supply counters keyed like nstats_t, the only row written on supply changes
+TBL supply_t {
+    nasset          supply;
+    nasset          max_supply;
+    bool            paused = false;
+
+    supply_t() {}
+
+    uint64_t primary_key()const { return supply.symbol.id; }
+
+    typedef eosio::multi_index< "supply"_n, supply_t > idx_t;
+
+    EOSLIB_SERIALIZE(supply_t, (supply)(max_supply)(paused) )
+};
+
+namespace holder_flag {
+    static constexpr uint8_t REBOUND    = 1 << 0;   // a held DID arrived through rebind
+};
+
+///Scope: _self, one row per account holding a positive DID balance
+TBL holder_t {
+    name            account;
+    vector<nsymbol> dids;           // DID symbols held by account
+    uint8_t         flags = 0;      // holder_flag bits
+
+    holder_t() {}
+    holder_t(const name& a): account(a) {}
+
+    uint64_t primary_key()const { return account.value; }
+
+    typedef eosio::multi_index< "holders"_n, holder_t > idx_t;
+
+    EOSLIB_SERIALIZE(holder_t, (account)(dids)(flags) )
+};
+
+///Scope: _self, holder counters per DID symbol id
+TBL holder_stats_t {
+    uint64_t        symbol_id;
+    uint64_t        holders     = 0;    // accounts with a positive balance
+    uint64_t        reclaimed   = 0;    // DIDs taken back by reclaim
+    uint64_t        rebinds     = 0;    // DIDs moved by rebind
+
+    holder_stats_t() {}
+    holder_stats_t(const uint64_t& id): symbol_id(id) {}
+
+    uint64_t primary_key()const { return symbol_id; }
+
+    typedef eosio::multi_index< "holderstats"_n, holder_stats_t > idx_t;
+
+    EOSLIB_SERIALIZE(holder_stats_t, (symbol_id)(holders)(reclaimed)(rebinds) )
+};
+
+///Scope: _self, checkpoint of an auditsupply run in progress, erased when the run finishes
+TBL supply_audit_t {
+    nsymbol         symbol;
+    name            cursor;             // next holder account to visit
+    int64_t         balances    = 0;    // partial sum of the balances visited so far
+    uint64_t        holders     = 0;    // visited accounts holding a positive balance of symbol
+    uint64_t        scanned     = 0;    // holder rows visited so far, whatever DIDs they hold
+    time_point_sec  started_at;
+
+    supply_audit_t() {}
+    supply_audit_t(const nsymbol& s): symbol(s) {}
+
+    uint64_t primary_key()const { return symbol.raw(); }
+
+    typedef eosio::multi_index< "supplyaudit"_n, supply_audit_t > idx_t;
+
+    EOSLIB_SERIALIZE(supply_audit_t, (symbol)(cursor)(balances)(holders)(scanned)(started_at) )
+};
+
+///Scope: _self, one row per notary allowed to notarize
+TBL notary_t {
+    name            account;
+
+    notary_t() {}
+    notary_t(const name& a): account(a) {}
+
+    uint64_t primary_key()const { return account.value; }
+
+    typedef eosio::multi_index< "notaries"_n, notary_t > idx_t;
+
+    EOSLIB_SERIALIZE(notary_t, (account) )
+};
+
+///Scope: owner's account, legacy layout drained into account_v2_t by migrateaccts
 TBL account_t {
     nasset      balance;
     bool        allow_send = false;
@@ -126,4 +222,47 @@ TBL account_t {
     typedef eosio::multi_index< "accounts"_n, account_t > idx_t;
 };
 
+namespace account_flag {
+    static constexpr uint8_t ALLOW_SEND = 1 << 0;
+    static constexpr uint8_t ALLOW_RECV = 1 << 1;
+    static constexpr uint8_t PAUSED     = 1 << 2;   // if set, it can no longer be transferred
+    static constexpr uint8_t HOLDS_ONE  = 1 << 3;   // balance is 1, amount left empty
+};
+
+///Scope: owner's account, compact account_t: 10 bytes for a 721-style DID instead of 19
+TBL account_v2_t {
+    nsymbol                 symbol;
+    uint8_t                 flags = 0;  // account_flag bits
+    std::optional<int64_t>  amount;     // only stored when the balance is neither 0 nor 1
+
+    account_v2_t() {}
+    account_v2_t(const account_t& a): symbol(a.balance.symbol) {
+        set_amount( a.balance.amount );
+        set_flag( account_flag::ALLOW_SEND, a.allow_send );
+        set_flag( account_flag::ALLOW_RECV, a.allow_recv );
+        set_flag( account_flag::PAUSED, a.paused );
+    }
+
+    uint64_t primary_key()const { return symbol.raw(); }
+
+    int64_t get_amount()const {
+        return amount.has_value() ? *amount : ( flags & account_flag::HOLDS_ONE ? 1 : 0 );
+    }
+    void set_amount(const int64_t& am) {
+        set_flag( account_flag::HOLDS_ONE, am == 1 );
+        if( am == 0 || am == 1 ) amount.reset();
+        else amount = am;
+    }
+    nasset balance()const { return nasset( get_amount(), symbol ); }
+
+    bool allow_send()const { return flags & account_flag::ALLOW_SEND; }
+    bool allow_recv()const { return flags & account_flag::ALLOW_RECV; }
+    bool paused()const     { return flags & account_flag::PAUSED; }
+    void set_flag(const uint8_t& flag, const bool& on) { flags = on ? ( flags | flag ) : ( flags & ~flag ); }
+
+    EOSLIB_SERIALIZE(account_v2_t, (symbol)(flags)(amount) )
+
+    typedef eosio::multi_index< "accountsv2"_n, account_v2_t > idx_t;
+};
+
 } //namespace amax
\ No newline at end of file
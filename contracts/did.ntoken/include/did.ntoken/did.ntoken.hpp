@@ -15,6 +15,28 @@ using std::vector;
 
 using namespace eosio;
 
+static constexpr uint32_t MAX_DISTRIBUTE_SIZE = 1000;
+static constexpr uint32_t MAX_TRANSFER_SIZE   = 100;
+static constexpr uint32_t MAX_RECLAIM_SIZE    = 200;
+static constexpr uint32_t MAX_MIGRATE_SIZE    = 100;
+static constexpr uint32_t MAX_SYNC_SIZE       = 100;
+static constexpr uint32_t MAX_VERIFY_SIZE     = 100;
+
+struct distribution_t {
+    name            to;
+    nasset          quantity;
+
+    EOSLIB_SERIALIZE( distribution_t, (to)(quantity) )
+};
+
+struct verification_t {
+    name            account;
+    nasset          balance;        // zero when the account has no row for the symbol
+    uint8_t         flags = 0;      // account_flag bits
+
+    EOSLIB_SERIALIZE( verification_t, (account)(balance)(flags) )
+};
+
 /**
  * The `did.ntoken` sample system contract defines the structures and actions that allow users to create, issue, and manage tokens for AMAX based blockchains. It demonstrates one way to implement a smart contract which allows for creation and management of tokens. It is possible for one to create a similar contract which suits different needs. However, it is recommended that if one only needs a token with the below listed actions, that one uses the `did.ntoken` contract instead of developing their own.
  *
@@ -32,9 +54,15 @@ class [[eosio::contract("did.ntoken")]] didtoken : public contract {
         _global(get_self(), get_self().value)
     {
         _gstate = _global.exists() ? _global.get() : global_t{};
+        _gstate_packed = pack( _gstate );
     }
 
-    ~didtoken() { _global.set( _gstate, get_self() ); }
+    ~didtoken() {
+        //only touched state is written back, so queries write nothing
+        flush_holder_stats();
+        if( pack( _gstate ) != _gstate_packed )
+            _global.set( _gstate, get_self() );
+    }
 
    /**
     * @brief Allows `issuer` account to create a token in supply of `maximum_supply`. If validation is successful a new entry in statsta
@@ -63,6 +91,15 @@ class [[eosio::contract("did.ntoken")]] didtoken : public contract {
     */
    ACTION reclaim( const name& target, const nsymbol& did, const string& memo );
 
+   /**
+    * @brief reclaim one DID symbol from a batch of disqualified accounts, with one supply update
+    *
+    * @param targets - up to MAX_RECLAIM_SIZE accounts, those without the DID are skipped
+    * @param did - DID symbol to reclaim
+    * @param memo - reclaim comment
+    */
+   ACTION reclaimmany( const vector<name>& targets, const nsymbol& did, const string& memo );
+
 	/**
 	 * @brief Transfers one or more assets.
 	 *
@@ -79,6 +116,20 @@ class [[eosio::contract("did.ntoken")]] didtoken : public contract {
    ACTION transfer( const name& from, const name& to, const vector<nasset>& assets, const string& memo );
    using transfer_action = action_wrapper< "transfer"_n, &didtoken::transfer >;
 
+   /**
+    * @brief Transfers DIDs from one account to many recipients.
+    *
+    * Each recipient is checked as in `transfer`, while the stats and sender rows
+    * are resolved once per symbol and debited once for the aggregate amount, so
+    * an issuer can airdrop a whole cohort in one action after a single `issue`.
+    *
+    * @param from - account who sends the DIDs
+    * @param distributions - up to MAX_DISTRIBUTE_SIZE {to, quantity} entries
+    * @param memo - transfer comment
+    */
+   ACTION distribute( const name& from, const vector<distribution_t>& distributions, const string& memo );
+   using distribute_action = action_wrapper< "distribute"_n, &didtoken::distribute >;
+
    /**
     * @brief DID admin orchestrated rebind process
     * 
@@ -98,6 +149,22 @@ class [[eosio::contract("did.ntoken")]] didtoken : public contract {
 
    ACTION settokenuri(const uint64_t& symbid, const string& url);
 
+   /**
+    * @brief store the token_uri hash on stats rows created before it was persisted, or left with a zero hash
+    *
+    * @param from_id - token id to resume from
+    * @param max_rows - max number of stats rows to visit
+    */
+   ACTION migratehash(const uint64_t& from_id, const uint32_t& max_rows);
+
+   /**
+    * @brief copy the supply of stats rows created before the supply split into the supply table
+    *
+    * @param from_id - token id to resume from
+    * @param max_rows - max number of stats rows to visit
+    */
+   ACTION migratesupply(const uint64_t& from_id, const uint32_t& max_rows);
+
    ACTION setnotary(const name& notary, const bool& to_add);
    /**
     * @brief notary to notarize a NFT asset by its token ID
@@ -111,10 +178,80 @@ class [[eosio::contract("did.ntoken")]] didtoken : public contract {
 
    ACTION setacctperms(const name& issuer, const name& to, const nsymbol& symbol,  const bool& allowsend, const bool& allowrecv);
 
+   /**
+    * @brief backfill the holders registry from the balances of accounts that held DIDs before it existed
+    *
+    * @param accounts - up to MAX_SYNC_SIZE account scopes of the accounts table, enumerated off-chain
+    */
+   ACTION syncholders(const vector<name>& accounts);
+
+   /**
+    * @brief move the rows of legacy accounts tables into the compact accountsv2 layout
+    *
+    * @param accounts - up to MAX_MIGRATE_SIZE account scopes, enumerated off-chain
+    */
+   ACTION migrateaccts(const vector<name>& accounts);
+
+   /**
+    * @brief query the holder, reclaim and rebind counters of a DID symbol, reported through an inline `holdstatlog`
+    *
+    * Queries change no state, the result is read from the holdstatlog trace of a pushed transaction: the caller
+    * signs and pays CPU for it, and did.ntoken needs eosio.code on its active permission to send the log.
+    * Without a transaction, get_table_rows on `holderstats` (scope did.ntoken, key symbol id) reads the same row.
+    */
+   ACTION getholdstats(const nsymbol& symbol);
+
+   ACTION holdstatlog(const holder_stats_t& stats);
+   using holdstatlog_action = action_wrapper< "holdstatlog"_n, &didtoken::holdstatlog >;
+
+   /**
+    * @brief query balance and permission flags of a DID symbol for each account, reported through an inline `verifylog`
+    *
+    * The results are read from the verifylog trace of a pushed transaction, signed and paid for by the caller,
+    * and did.ntoken needs eosio.code on its active permission to send the log. Without a transaction, each
+    * account is read by get_table_rows on `accountsv2` and then `accounts` (scope account, key symbol raw).
+    *
+    * @param accounts - up to MAX_VERIFY_SIZE accounts
+    * @param symbol - DID symbol to verify
+    */
+   ACTION verify(const vector<name>& accounts, const nsymbol& symbol);
+
+   ACTION verifylog(const vector<verification_t>& results);
+   using verifylog_action = action_wrapper< "verifylog"_n, &didtoken::verifylog >;
+
+   /**
+    * @brief check that the balances of a DID symbol add up to its supply, one page of holders per call
+    *
+    * Holders are read from the holders registry, so accounts not backfilled by syncholders are not counted.
+    * The partial sum is kept in the supplyaudit table between calls and auditlog is sent once all holders
+    * are visited, after which the next call starts a new run.
+    *
+    * @param symbol - DID symbol to audit
+    * @param max_scopes - max number of holder accounts to visit in this call
+    */
+   ACTION auditsupply(const nsymbol& symbol, const uint32_t& max_scopes);
+
+   /**
+    * @brief inline log of a finished auditsupply run, balances equal supply when the invariant holds
+    *
+    * @param holders - accounts found with a positive balance of symbol
+    * @param scanned - holder rows visited by the run
+    */
+   ACTION auditlog(const nsymbol& symbol, const nasset& supply, const int64_t& balances, const uint64_t& holders, const uint64_t& scanned, const time_point_sec& started_at);
+   using auditlog_action = action_wrapper< "auditlog"_n, &didtoken::auditlog >;
+
 
    private:
-      void add_balance( const name& owner, const nasset& value, const name& ram_payer );
+      void add_balance( const name& owner, const nasset& value, const name& ram_payer, const uint8_t& holder_flags = 0 );
       void sub_balance( const name& owner, const nasset& value, const name& ram_payer );
+      int64_t reclaim_balance( const name& target, const nsymbol& did );
+      std::optional<account_v2_t> read_account( const name& owner, const nsymbol& symbol );
+      account_v2_t::idx_t::const_iterator find_account( account_v2_t::idx_t& acnts, const nsymbol& symbol, const name& ram_payer );
+      const supply_t& get_supply( supply_t::idx_t& supplies, nstats_t::idx_t& nstats, const nstats_t& st );
+
+      void update_holder( const name& owner, const nsymbol& did, const int64_t& prev_amount, const int64_t& amount, const uint8_t& flags = 0 );
+      holder_stats_t& get_holder_stats( const uint64_t& symbol_id );
+      void flush_holder_stats();
 
       inline void require_issuer(const name& issuer, const nsymbol& sym) {
          nstats_t::idx_t tokenstats( get_self(), sym.raw() );
@@ -126,5 +263,7 @@ class [[eosio::contract("did.ntoken")]] didtoken : public contract {
    private:
       global_singleton    _global;
       global_t            _gstate;
+      vector<char>        _gstate_packed;   //global as loaded, to skip unchanged writes
+      map<uint64_t, holder_stats_t> _holder_stats;   //loaded on first touch, written once by the destructor
 };
 } //namespace amax
@@ -28,24 +28,41 @@ void didtoken::create( const name& issuer, const int64_t& maximum_supply, const
       nsymb.id         = nstats.available_primary_key();
 
    nstats.emplace( issuer, [&]( auto& s ) {
-      s.supply.symbol   = nsymb;
-      s.max_supply      = nasset( maximum_supply, symbol );
+      s.supply          = nasset( SUPPLY_MOVED, nsymb );
+      s.max_supply      = nasset( SUPPLY_MOVED, symbol );
       s.token_uri       = token_uri;
       s.ipowner         = ipowner;
       s.issuer          = issuer;
       s.issued_at       = current_time_point();
+      s.token_uri_hash.emplace( token_uri_hash );
+   });
+
+   auto supplies        = supply_t::idx_t( _self, _self.value );
+   supplies.emplace( issuer, [&]( auto& s ) {
+      s.supply.symbol   = nsymb;
+      s.max_supply      = nasset( maximum_supply, symbol );
    });
 }
 
 void didtoken::setnotary(const name& notary, const bool& to_add) {
    require_auth( _self );
 
-   if (to_add)
-      _gstate.notaries.insert(notary);
+   auto notaries = notary_t::idx_t( _self, _self.value );
+   //notaries kept in the global before the registry are moved over on the first call
+   for( const auto& legacy : _gstate.notaries ) {
+      if( notaries.find( legacy.value ) == notaries.end() )
+         notaries.emplace( _self, [&]( auto& n ) { n.account = legacy; });
+   }
+   _gstate.notaries.clear();
 
-   else
-      _gstate.notaries.erase(notary);
+   auto itr = notaries.find( notary.value );
+   if (to_add) {
+      if( itr == notaries.end() )
+         notaries.emplace( _self, [&]( auto& n ) { n.account = notary; });
 
+   } else if( itr != notaries.end() ) {
+      notaries.erase( itr );
+   }
 }
 
 void didtoken::settokenuri(const uint64_t& symbid, const string& url) {
@@ -57,12 +74,41 @@ void didtoken::settokenuri(const uint64_t& symbid, const string& url) {
 
    nstats.modify( itr, same_payer, [&](auto& row){
       row.token_uri     = url;
+      row.token_uri_hash.emplace( HASH256(url) );
    });
 }
 
+void didtoken::migratesupply(const uint64_t& from_id, const uint32_t& max_rows) {
+   require_auth( _self );
+   check( max_rows > 0, "max_rows must be positive" );
+
+   auto nstats          = nstats_t::idx_t( _self, _self.value );
+   auto supplies        = supply_t::idx_t( _self, _self.value );
+   auto itr             = nstats.lower_bound( from_id );
+   for (uint32_t count = 0; count < max_rows && itr != nstats.end(); count++, itr++) {
+      get_supply( supplies, nstats, *itr );
+   }
+}
+
+void didtoken::migratehash(const uint64_t& from_id, const uint32_t& max_rows) {
+   require_auth( _self );
+   check( max_rows > 0, "max_rows must be positive" );
+
+   auto nstats          = nstats_t::idx_t( _self, _self.value );
+   auto itr             = nstats.lower_bound( from_id );
+   for (uint32_t count = 0; count < max_rows && itr != nstats.end(); count++, itr++) {
+      if (itr->has_token_uri_hash()) continue;
+
+      nstats.modify( itr, same_payer, [&](auto& row){
+         row.fill_token_uri_hash();
+      });
+   }
+}
+
 void didtoken::notarize(const name& notary, const uint32_t& token_id) {
    require_auth( notary );
-   check( _gstate.notaries.find(notary) != _gstate.notaries.end(), "not authorized notary" );
+   auto notaries = notary_t::idx_t( _self, _self.value );
+   check( notaries.find( notary.value ) != notaries.end() || _gstate.notaries.count( notary ), "not authorized notary" );
 
    auto nstats = nstats_t::idx_t( _self, _self.value );
    auto itr = nstats.find( token_id );
@@ -70,6 +116,7 @@ void didtoken::notarize(const name& notary, const uint32_t& token_id) {
    nstats.modify( itr, same_payer, [&]( auto& row ) {
       row.notary = notary;
       row.notarized_at = time_point_sec( current_time_point()  );
+      row.fill_token_uri_hash();
     });
 }
 
@@ -90,9 +137,12 @@ void didtoken::issue( const name& to, const nasset& quantity, const string& memo
     check( quantity.amount > 0, "must issue positive quantity" );
 
     check( quantity.symbol == st.supply.symbol, "symbol mismatch" );
-    check( quantity.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
 
-    nstats.modify( st, same_payer, [&]( auto& s ) {
+    auto supplies = supply_t::idx_t( _self, _self.value );
+    const auto& sp = get_supply( supplies, nstats, st );
+    check( quantity.amount <= sp.max_supply.amount - sp.supply.amount, "quantity exceeds available supply");
+
+    supplies.modify( sp, same_payer, [&]( auto& s ) {
        s.supply += quantity;
     });
 
@@ -116,7 +166,8 @@ void didtoken::retire( const nasset& quantity, const string& memo )
 
     check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
 
-    nstats.modify( st, same_payer, [&]( auto& s ) {
+    auto supplies = supply_t::idx_t( _self, _self.value );
+    supplies.modify( get_supply( supplies, nstats, st ), same_payer, [&]( auto& s ) {
        s.supply -= quantity;
     });
 
@@ -140,46 +191,67 @@ void didtoken::burn( const name& owner,const nasset& quantity, const string& mem
 
    check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
 
-   nstats.modify( st, same_payer, [&]( auto& s ) {
+   auto supplies = supply_t::idx_t( _self, _self.value );
+   supplies.modify( get_supply( supplies, nstats, st ), same_payer, [&]( auto& s ) {
       s.supply -= quantity;
    });
 
-   auto from_acnts = account_t::idx_t( get_self(), owner.value );
+   auto from_acnts = account_v2_t::idx_t( get_self(), owner.value );
 
-   const auto& from = from_acnts.get( quantity.symbol.raw(), "no balance object found" );
-   check( from.balance.amount >= quantity.amount, "overdrawn balance" );
+   auto from = find_account( from_acnts, quantity.symbol, st.issuer );
+   check( from != from_acnts.end(), "no balance object found" );
+   check( from->get_amount() >= quantity.amount, "overdrawn balance" );
 
    from_acnts.modify( from, same_payer, [&]( auto& a ) {
-      a.balance -= quantity;
+      a.set_amount( a.get_amount() - quantity.amount );
    });
+   update_holder( owner, quantity.symbol, from->get_amount() + quantity.amount, from->get_amount() );
 }
 
 void didtoken::reclaim( const name& target, const nsymbol& did, const string& memo ) {
    check( has_auth( "amax"_n ) || has_auth("armoniaadmin"_n), "not autorized to reclaim" );
    check( memo.size() <= 256, "memo has more than 256 bytes" );
 
-   // sub_balance( target, quantity );
-   account_t::idx_t from_acnts( get_self(), target.value );
-   const auto& from = from_acnts.get( did.raw(), "no balance object found" );
-   check( from.balance.amount >= 1, "DID not found" );
-   auto prev_amount = from.balance.amount;
-
-   from_acnts.modify( from, same_payer, [&]( auto& a ) {
-      a.balance.amount = 0;
-   });
+   auto prev_amount = reclaim_balance( target, did );
+   check( prev_amount >= 1, "DID not found" );
 
-   nstats_t::idx_t statstable( get_self(), did.raw() );
-   auto existing = statstable.find( did.raw() );
-   check( existing != statstable.end(), "token with symbol does not exist" );
-   const auto& st = *existing;
+   auto nstats = nstats_t::idx_t( _self, _self.value );
+   const auto& st = nstats.get( did.id, "token with symbol does not exist" );
 
-   statstable.modify( st, same_payer, [&]( auto& s ) {
+   auto supplies = supply_t::idx_t( _self, _self.value );
+   supplies.modify( get_supply( supplies, nstats, st ), same_payer, [&]( auto& s ) {
       s.supply.amount -= prev_amount;
    });
 
    require_recipient( target );
 }
 
+void didtoken::reclaimmany( const vector<name>& targets, const nsymbol& did, const string& memo ) {
+   check( has_auth( "amax"_n ) || has_auth("armoniaadmin"_n), "not autorized to reclaim" );
+   check( targets.size() > 0, "empty targets" );
+   check( targets.size() <= MAX_RECLAIM_SIZE, "targets size exceeds " + to_string(MAX_RECLAIM_SIZE) );
+   check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+   auto nstats = nstats_t::idx_t( _self, _self.value );
+   const auto& st = nstats.get( did.id, "token with symbol does not exist" );
+
+   //targets already without the DID are skipped, so a revocation list can be resubmitted
+   int64_t reclaimed = 0;
+   for( const auto& target : targets ) {
+      auto prev_amount = reclaim_balance( target, did );
+      if( prev_amount == 0 ) continue;
+
+      reclaimed += prev_amount;
+      require_recipient( target );
+   }
+   check( reclaimed > 0, "DID not found on any target" );
+
+   auto supplies = supply_t::idx_t( _self, _self.value );
+   supplies.modify( get_supply( supplies, nstats, st ), same_payer, [&]( auto& s ) {
+      s.supply.amount -= reclaimed;
+   });
+}
+
 void didtoken::transfer( const name& from, const name& to, const vector<nasset>& assets, const string& memo  )
 {
    check( from != to, "cannot transfer to self" );
@@ -191,29 +263,117 @@ void didtoken::transfer( const name& from, const name& to, const vector<nasset>&
    require_recipient( from );
    require_recipient( to );
 
-   check (assets.size() == 1, "assets size must be 1");
+   check( assets.size() > 0, "empty assets" );
+   check( assets.size() <= MAX_TRANSFER_SIZE, "assets size exceeds " + to_string(MAX_TRANSFER_SIZE) );
+
+   //table handles are opened once per action, rows are resolved by symbol
+   auto nstats = nstats_t::idx_t( _self, _self.value );
+   auto from_acnts = account_v2_t::idx_t( get_self(), from.value );
+   auto to_acnts = account_v2_t::idx_t( get_self(), to.value );
    for( auto& quantity : assets) {
-      auto sym = quantity.symbol;
-      auto nstats = nstats_t::idx_t( _self, _self.value );
-      const auto& st = nstats.get( sym.id );
+      check( quantity.is_valid(), "invalid quantity" );
+      check( quantity.amount > 0, "must transfer positive quantity" );
+
+      const auto& st = nstats.get( quantity.symbol.id, "token with symbol does not exist" );
+      check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
 
-      auto from_acnts = account_t::idx_t( get_self(), from.value );
-      const auto& from_acnt = from_acnts.get( quantity.symbol.raw(), "no balance object found" );
+      auto from_acnt = find_account( from_acnts, quantity.symbol, from );
+      check( from_acnt != from_acnts.end(), "no balance object found" );
+      check( from_acnt->get_amount() >= quantity.amount, "overdrawn balance" );
 
-      auto to_acnts = account_t::idx_t( get_self(), to.value );
-      auto to_acnt = to_acnts.find( quantity.symbol.raw() );
-      check( to_acnt == to_acnts.end() || to_acnt->balance.amount == 0, "You can't receive more than one DID token" );
+      auto to_acnt = find_account( to_acnts, quantity.symbol, payer );
+      check( to_acnt == to_acnts.end() || to_acnt->get_amount() == 0, "You can't receive more than one DID token" );
    
-      if ( !from_acnt.allow_send ) {
-         check( to_acnt != to_acnts.end() && to_acnt->allow_recv, "no permistion for transfer" );
+      if ( !from_acnt->allow_send() ) {
+         check( to_acnt != to_acnts.end() && to_acnt->allow_recv(), "no permistion for transfer" );
       }
 
+      from_acnts.modify( from_acnt, from, [&]( auto& a ) {
+         a.set_amount( a.get_amount() - quantity.amount );
+      });
+      update_holder( from, quantity.symbol, from_acnt->get_amount() + quantity.amount, from_acnt->get_amount() );
+
+      if( to_acnt == to_acnts.end() ) {
+         to_acnts.emplace( payer, [&]( auto& a ){
+            a.symbol = quantity.symbol;
+            a.set_amount( quantity.amount );
+         });
+         update_holder( to, quantity.symbol, 0, quantity.amount );
+      } else {
+         to_acnts.modify( to_acnt, same_payer, [&]( auto& a ) {
+            a.set_amount( a.get_amount() + quantity.amount );
+         });
+         update_holder( to, quantity.symbol, to_acnt->get_amount() - quantity.amount, to_acnt->get_amount() );
+      }
+   }
+}
+
+void didtoken::distribute( const name& from, const vector<distribution_t>& distributions, const string& memo )
+{
+   require_auth( from );
+   check( distributions.size() > 0, "empty distributions" );
+   check( distributions.size() <= MAX_DISTRIBUTE_SIZE, "distributions size exceeds " + to_string(MAX_DISTRIBUTE_SIZE) );
+   check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+   require_recipient( from );
+
+   //per-symbol state resolved once: stats row, sender row and the aggregate debit
+   struct symbol_state_t {
+      const account_v2_t*  from_acnt;
+      nasset            debit;
+   };
+   map<uint64_t, symbol_state_t> symbols;
+
+   auto nstats = nstats_t::idx_t( _self, _self.value );
+   auto from_acnts = account_v2_t::idx_t( get_self(), from.value );
+   for( const auto& dist : distributions ) {
+      const auto& quantity = dist.quantity;
+      check( dist.to != from, "cannot transfer to self" );
       check( quantity.is_valid(), "invalid quantity" );
       check( quantity.amount > 0, "must transfer positive quantity" );
-      check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
 
-      sub_balance( from, quantity, from );
-      add_balance( to, quantity, payer );
+      auto sym_itr = symbols.find( quantity.symbol.raw() );
+      if( sym_itr == symbols.end() ) {
+         const auto& st = nstats.get( quantity.symbol.id, "token with symbol does not exist" );
+         check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+         auto from_acnt = find_account( from_acnts, quantity.symbol, from );
+         check( from_acnt != from_acnts.end(), "no balance object found" );
+         sym_itr = symbols.emplace( quantity.symbol.raw(), symbol_state_t{ &*from_acnt, nasset(0, quantity.symbol) } ).first;
+      }
+      auto& state = sym_itr->second;
+
+      //recipient row is checked and written through the same handle, a single lookup per recipient
+      auto to_acnts = account_v2_t::idx_t( get_self(), dist.to.value );
+      auto to_acnt = find_account( to_acnts, quantity.symbol, from );
+      check( to_acnt == to_acnts.end() || to_acnt->get_amount() == 0, "You can't receive more than one DID token" );
+      if ( !state.from_acnt->allow_send() ) {
+         check( to_acnt != to_acnts.end() && to_acnt->allow_recv(), "no permistion for transfer" );
+      }
+
+      if( to_acnt == to_acnts.end() ) {
+         check( is_account( dist.to ), "to account does not exist: " + dist.to.to_string() );
+         to_acnts.emplace( from, [&]( auto& a ){
+            a.symbol = quantity.symbol;
+            a.set_amount( quantity.amount );
+         });
+         update_holder( dist.to, quantity.symbol, 0, quantity.amount );
+      } else {
+         to_acnts.modify( to_acnt, same_payer, [&]( auto& a ) {
+            a.set_amount( a.get_amount() + quantity.amount );
+         });
+         update_holder( dist.to, quantity.symbol, to_acnt->get_amount() - quantity.amount, to_acnt->get_amount() );
+      }
+      require_recipient( dist.to );
+
+      state.debit += quantity;
+   }
+
+   for( const auto& [raw, state] : symbols ) {
+      check( state.from_acnt->get_amount() >= state.debit.amount, "overdrawn balance" );
+      from_acnts.modify( *state.from_acnt, from, [&]( auto& a ) {
+         a.set_amount( a.get_amount() - state.debit.amount );
+      });
+      update_holder( from, state.debit.symbol, state.from_acnt->get_amount() + state.debit.amount, state.from_acnt->get_amount() );
    }
 }
 
@@ -225,35 +385,291 @@ void didtoken::rebind( const name& from, const name&to, const nasset& did ) {
    check( is_account( to ), "to account does not exist");
 
    sub_balance( from, did, admin );
-   add_balance( to, did, admin );
+   add_balance( to, did, admin, holder_flag::REBOUND );
+   get_holder_stats( did.symbol.id ).rebinds++;
+}
+
+const supply_t& didtoken::get_supply( supply_t::idx_t& supplies, nstats_t::idx_t& nstats, const nstats_t& st ) {
+   auto itr = supplies.find( st.supply.symbol.id );
+   if( itr != supplies.end() ) return *itr;
+
+   //tokens created before the split carry their supply on the stats row
+   const auto& sp = *supplies.emplace( _self, [&]( auto& s ) {
+      s.supply          = st.supply;
+      s.max_supply      = st.max_supply;
+      s.paused          = st.paused;
+   });
+
+   //the stats copy is tombstoned, so readers of tokenstats cannot mistake it for the live supply
+   nstats.modify( st, same_payer, [&]( auto& row ) {
+      row.supply.amount       = SUPPLY_MOVED;
+      row.max_supply.amount   = SUPPLY_MOVED;
+      row.paused              = false;
+      row.fill_token_uri_hash();
+   });
+   return sp;
+}
+
+int64_t didtoken::reclaim_balance( const name& target, const nsymbol& did ) {
+   account_v2_t::idx_t acnts( get_self(), target.value );
+   auto itr = find_account( acnts, did, _self );
+   if( itr == acnts.end() || itr->get_amount() <= 0 ) return 0;
+
+   auto prev_amount = itr->get_amount();
+   acnts.modify( itr, same_payer, [&]( auto& a ) {
+      a.set_amount( 0 );
+   });
+   update_holder( target, did, prev_amount, 0 );
+   get_holder_stats( did.id ).reclaimed++;
+   return prev_amount;
 }
 
 void didtoken::sub_balance( const name& owner, const nasset& value, const name& ram_payer ) {
-   auto from_acnts = account_t::idx_t( get_self(), owner.value );
+   auto from_acnts = account_v2_t::idx_t( get_self(), owner.value );
 
-   const auto& from = from_acnts.get( value.symbol.raw(), "no balance object found" );
-   check( from.balance.amount >= value.amount, "overdrawn balance" );
+   auto from = find_account( from_acnts, value.symbol, ram_payer );
+   check( from != from_acnts.end(), "no balance object found" );
+   check( from->get_amount() >= value.amount, "overdrawn balance" );
 
    from_acnts.modify( from, ram_payer, [&]( auto& a ) {
-      a.balance -= value;
+      a.set_amount( a.get_amount() - value.amount );
    });
+   update_holder( owner, value.symbol, from->get_amount() + value.amount, from->get_amount() );
 }
 
-void didtoken::add_balance( const name& owner, const nasset& value, const name& ram_payer )
+void didtoken::add_balance( const name& owner, const nasset& value, const name& ram_payer, const uint8_t& holder_flags )
 {
-   auto to_acnts = account_t::idx_t( get_self(), owner.value );
-   auto to = to_acnts.find( value.symbol.raw() );
+   auto to_acnts = account_v2_t::idx_t( get_self(), owner.value );
+   auto to = find_account( to_acnts, value.symbol, ram_payer );
+   int64_t prev_amount = 0;
    if( to == to_acnts.end() ) {
       to_acnts.emplace( ram_payer, [&]( auto& a ){
-        a.balance = value;
+        a.symbol = value.symbol;
+        a.set_amount( value.amount );
       });
    } else {
+      prev_amount = to->get_amount();
       to_acnts.modify( to, same_payer, [&]( auto& a ) {
-        a.balance += value;
+        a.set_amount( prev_amount + value.amount );
+      });
+   }
+   update_holder( owner, value.symbol, prev_amount, prev_amount + value.amount, holder_flags );
+}
+
+account_v2_t::idx_t::const_iterator didtoken::find_account( account_v2_t::idx_t& acnts, const nsymbol& symbol, const name& ram_payer )
+{
+   auto itr = acnts.find( symbol.raw() );
+   if( itr != acnts.end() ) return itr;
+
+   //rows written before the compact layout are converted on first touch
+   auto legacy_acnts = account_t::idx_t( get_self(), acnts.get_scope() );
+   auto legacy = legacy_acnts.find( symbol.raw() );
+   if( legacy == legacy_acnts.end() ) return itr;
+
+   //the owner pays for its own row, a row touched by anyone else is converted on the contract
+   auto payer = ram_payer == name( acnts.get_scope() ) ? ram_payer : get_self();
+   account_v2_t row( *legacy );
+   legacy_acnts.erase( legacy );
+   return acnts.emplace( payer, [&]( auto& a ) { a = row; });
+}
+
+std::optional<account_v2_t> didtoken::read_account( const name& owner, const nsymbol& symbol )
+{
+   auto acnts = account_v2_t::idx_t( get_self(), owner.value );
+   auto itr = acnts.find( symbol.raw() );
+   if( itr != acnts.end() ) return *itr;
+
+   auto legacy_acnts = account_t::idx_t( get_self(), owner.value );
+   auto legacy = legacy_acnts.find( symbol.raw() );
+   if( legacy != legacy_acnts.end() ) return account_v2_t( *legacy );
+   return std::nullopt;
+}
+
+void didtoken::update_holder( const name& owner, const nsymbol& did, const int64_t& prev_amount, const int64_t& amount, const uint8_t& flags )
+{
+   //only a balance crossing zero changes the registry
+   if( (prev_amount > 0) == (amount > 0) ) return;
+
+   auto holders = holder_t::idx_t( _self, _self.value );
+   auto itr = holders.find( owner.value );
+   if( amount > 0 ) {
+      get_holder_stats( did.id ).holders++;
+      if( itr == holders.end() ) {
+         holders.emplace( _self, [&]( auto& h ) {
+            h.account   = owner;
+            h.dids      = { did };
+            h.flags     = flags;
+         });
+      } else {
+         holders.modify( itr, same_payer, [&]( auto& h ) {
+            h.dids.push_back( did );
+            h.flags    |= flags;
+         });
+      }
+      return;
+   }
+
+   //a holder not backfilled by syncholders yet was never counted
+   if( itr == holders.end() ) return;
+   if( std::find( itr->dids.begin(), itr->dids.end(), did ) == itr->dids.end() ) return;
+
+   auto& stats = get_holder_stats( did.id );
+   if( stats.holders > 0 ) stats.holders--;
+   if( itr->dids.size() <= 1 ) {
+      holders.erase( itr );
+   } else {
+      holders.modify( itr, same_payer, [&]( auto& h ) {
+         h.dids.erase( std::remove( h.dids.begin(), h.dids.end(), did ), h.dids.end() );
       });
    }
 }
 
+holder_stats_t& didtoken::get_holder_stats( const uint64_t& symbol_id )
+{
+   auto itr = _holder_stats.find( symbol_id );
+   if( itr != _holder_stats.end() ) return itr->second;
+
+   auto holder_stats = holder_stats_t::idx_t( _self, _self.value );
+   auto stats_itr = holder_stats.find( symbol_id );
+   return _holder_stats.emplace( symbol_id, stats_itr != holder_stats.end() ? *stats_itr : holder_stats_t( symbol_id ) ).first->second;
+}
+
+void didtoken::flush_holder_stats()
+{
+   auto holder_stats = holder_stats_t::idx_t( _self, _self.value );
+   for( const auto& [symbol_id, stats] : _holder_stats ) {
+      auto itr = holder_stats.find( symbol_id );
+      if( itr == holder_stats.end() ) {
+         holder_stats.emplace( _self, [&]( auto& row ) { row = stats; });
+      } else {
+         holder_stats.modify( itr, same_payer, [&]( auto& row ) { row = stats; });
+      }
+   }
+}
+
+void didtoken::syncholders( const vector<name>& accounts )
+{
+   require_auth( _self );
+   check( accounts.size() > 0, "empty accounts" );
+   check( accounts.size() <= MAX_SYNC_SIZE, "accounts size exceeds " + to_string(MAX_SYNC_SIZE) );
+
+   //idempotent, symbols already registered for an account are skipped
+   auto holders = holder_t::idx_t( _self, _self.value );
+   for( const auto& account : accounts ) {
+      auto sync = [&]( const nasset& balance ) {
+         if( balance.amount <= 0 ) return;
+
+         auto itr = holders.find( account.value );
+         if( itr != holders.end() && std::find( itr->dids.begin(), itr->dids.end(), balance.symbol ) != itr->dids.end() )
+            return;
+         update_holder( account, balance.symbol, 0, balance.amount );
+      };
+
+      //both layouts are read while the account migration is in progress
+      for( const auto& acnt : account_v2_t::idx_t( get_self(), account.value ) )
+         sync( acnt.balance() );
+      for( const auto& acnt : account_t::idx_t( get_self(), account.value ) )
+         sync( acnt.balance );
+   }
+}
+
+void didtoken::migrateaccts( const vector<name>& accounts )
+{
+   require_auth( _self );
+   check( accounts.size() > 0, "empty accounts" );
+   check( accounts.size() <= MAX_MIGRATE_SIZE, "accounts size exceeds " + to_string(MAX_MIGRATE_SIZE) );
+
+   for( const auto& account : accounts ) {
+      auto legacy_acnts = account_t::idx_t( get_self(), account.value );
+      auto acnts = account_v2_t::idx_t( get_self(), account.value );
+      for( auto itr = legacy_acnts.begin(); itr != legacy_acnts.end(); ) {
+         acnts.emplace( _self, [&]( auto& a ) { a = account_v2_t( *itr ); });
+         itr = legacy_acnts.erase( itr );
+      }
+   }
+}
+
+void didtoken::getholdstats( const nsymbol& symbol )
+{
+   auto holder_stats = holder_stats_t::idx_t( _self, _self.value );
+   const auto& stats = holder_stats.get( symbol.id, "holder stats not found" );
+   holdstatlog_action( _self, { {_self, "active"_n} } ).send( stats );
+}
+
+void didtoken::holdstatlog( const holder_stats_t& stats )
+{
+   require_auth( _self );
+}
+
+void didtoken::verify( const vector<name>& accounts, const nsymbol& symbol )
+{
+   check( accounts.size() <= MAX_VERIFY_SIZE, "accounts size exceeds " + to_string(MAX_VERIFY_SIZE) );
+
+   vector<verification_t> results;
+   results.reserve( accounts.size() );
+   for( const auto& account : accounts ) {
+      auto acnt = read_account( account, symbol );
+      if( acnt ) results.push_back( { account, acnt->balance(), acnt->flags } );
+      else results.push_back( { account, nasset(0, symbol), 0 } );
+   }
+   verifylog_action( _self, { {_self, "active"_n} } ).send( results );
+}
+
+void didtoken::verifylog( const vector<verification_t>& results )
+{
+   require_auth( _self );
+}
+
+void didtoken::auditsupply( const nsymbol& symbol, const uint32_t& max_scopes )
+{
+   check( has_auth( _self ) || has_auth("armoniaadmin"_n), "not authorized to audit" );
+   check( max_scopes > 0, "max_scopes must be positive" );
+
+   auto nstats = nstats_t::idx_t( _self, _self.value );
+   const auto& st = nstats.get( symbol.id, "token with symbol does not exist" );
+   check( symbol == st.supply.symbol, "symbol precision mismatch" );
+
+   auto audits = supply_audit_t::idx_t( _self, _self.value );
+   auto audit_itr = audits.find( symbol.raw() );
+   supply_audit_t audit( symbol );
+   if( audit_itr != audits.end() ) audit = *audit_itr;
+   else audit.started_at = time_point_sec( current_time_point() );
+
+   auto holders = holder_t::idx_t( _self, _self.value );
+   auto itr = holders.lower_bound( audit.cursor.value );
+   for( uint32_t count = 0; count < max_scopes && itr != holders.end(); count++, itr++ ) {
+      audit.scanned++;
+      if( std::find( itr->dids.begin(), itr->dids.end(), symbol ) == itr->dids.end() ) continue;
+
+      auto acnt = read_account( itr->account, symbol );
+      if( !acnt || acnt->get_amount() <= 0 ) continue;
+      audit.balances += acnt->get_amount();
+      audit.holders++;
+   }
+
+   if( itr != holders.end() ) {
+      audit.cursor = itr->account;
+      if( audit_itr == audits.end() ) {
+         audits.emplace( _self, [&]( auto& row ) { row = audit; });
+      } else {
+         audits.modify( audit_itr, same_payer, [&]( auto& row ) { row = audit; });
+      }
+      return;
+   }
+
+   auto supplies = supply_t::idx_t( _self, _self.value );
+   auto supply_itr = supplies.find( symbol.id );
+   auto supply = supply_itr != supplies.end() ? supply_itr->supply : st.supply;
+
+   auditlog_action( _self, { {_self, "active"_n} } ).send( symbol, supply, audit.balances, audit.holders, audit.scanned, audit.started_at );
+   if( audit_itr != audits.end() ) audits.erase( audit_itr );
+}
+
+void didtoken::auditlog( const nsymbol& symbol, const nasset& supply, const int64_t& balances, const uint64_t& holders, const uint64_t& scanned, const time_point_sec& started_at )
+{
+   require_auth( _self );
+}
+
 void didtoken::setacctperms(const name& issuer, const name& to, const nsymbol& symbol,  const bool& allowsend, const bool& allowrecv) {
    require_auth( issuer );
    check( is_account( to ), "to account does not exist");
@@ -262,19 +678,19 @@ void didtoken::setacctperms(const name& issuer, const name& to, const nsymbol& s
    const auto& st = nstats.get( symbol.id );
    check( issuer == st.issuer, "issuer: " + st.issuer.to_string() + " vs " + issuer.to_string() );
 
-   auto acnts = account_t::idx_t( get_self(), to.value );
-   const auto& it = acnts.find( symbol.raw());
+   auto acnts = account_v2_t::idx_t( get_self(), to.value );
+   auto it = find_account( acnts, symbol, issuer );
 
     if( it == acnts.end() ) {
       acnts.emplace( issuer, [&]( auto& a ){
-        a.balance = nasset(0, symbol);
-        a.allow_send = allowsend;
-        a.allow_recv = allowrecv;
+        a.symbol = symbol;
+        a.set_flag( account_flag::ALLOW_SEND, allowsend );
+        a.set_flag( account_flag::ALLOW_RECV, allowrecv );
       });
    } else {
       acnts.modify( it, issuer, [&]( auto& a ) {
-        a.allow_send = allowsend;
-        a.allow_recv = allowrecv;
+        a.set_flag( account_flag::ALLOW_SEND, allowsend );
+        a.set_flag( account_flag::ALLOW_RECV, allowrecv );
       });
    }
 
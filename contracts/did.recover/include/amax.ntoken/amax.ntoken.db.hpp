@@ -87,5 +87,20 @@ struct account_t {
     typedef eosio::multi_index< "accounts"_n, account_t > idx_t;
 };
 
+///Scope: owner's account, compact layout that did.ntoken migrates account_t into
+struct account_v2_t {
+    nsymbol                 symbol;             //PK
+    uint8_t                 flags = 0;
+    std::optional<int64_t>  amount;
+
+    account_v2_t() {}
+
+    uint64_t primary_key()const { return symbol.raw(); }
+
+    EOSLIB_SERIALIZE(account_v2_t, (symbol)(flags)(amount) )
+
+    typedef eosio::multi_index< "accountsv2"_n, account_v2_t > idx_t;
+};
+
 
 } //namespace amax
\ No newline at end of file
@@ -185,9 +185,10 @@ namespace amax {
       
       CHECKC( owner != account, err::PARAM_ERROR, "Unable to submit one's own account")
 
-      auto accounts = ntoken::account_t::idx_t( DID_CONTRACTT, account.value );
-      auto did_itr = accounts.find( DID_SYMBOL_ID );
-      CHECKC( did_itr !=  accounts.end() ,err::ACCOUNT_INVALID , "Non DID users")
+      auto accounts = ntoken::account_v2_t::idx_t( DID_CONTRACTT, account.value );
+      auto legacy_accounts = ntoken::account_t::idx_t( DID_CONTRACTT, account.value );
+      CHECKC( accounts.find( DID_SYMBOL_ID ) != accounts.end() || legacy_accounts.find( DID_SYMBOL_ID ) != legacy_accounts.end(),
+              err::ACCOUNT_INVALID , "Non DID users")
 
       recover_order_t::idx_t orders( _self, _self.value );
       auto account_idx   = orders.get_index<"accountidx"_n>();
@@ -66,6 +66,7 @@ class [[eosio::contract("did.redpack")]] redpack : public eosio::contract {
    }
 
    ACTION setfee(const extended_asset &fee);
+   ACTION setholdsync(const bool &synced);
 
    ACTION whitelist(const name &contract, const symbol &sym, const time_point_sec &expired_time);
    ACTION deltoken(const uint64_t &token_id);
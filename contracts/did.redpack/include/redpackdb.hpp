@@ -1,6 +1,7 @@
 #pragma once
 
 #include <eosio/asset.hpp>
+#include <eosio/binary_extension.hpp>
 #include <eosio/eosio.hpp>
 #include <eosio/privileged.hpp>
 #include <eosio/singleton.hpp>
@@ -52,8 +53,9 @@ namespace wasm { namespace db {
       name           did_contract;
       uint64_t       did_id;
       extended_asset fee;
+      binary_extension<bool> holders_synced; // did.ntoken holders registry fully backfilled, DID checks skip the balance scans
 
-      EOSLIB_SERIALIZE(global_t2, (did_contract)(did_id)(fee))
+      EOSLIB_SERIALIZE(global_t2, (did_contract)(did_id)(fee)(holders_synced))
    };
    typedef eosio::singleton<"global2"_n, global_t2> global_singleton2;
 
@@ -32,6 +32,12 @@ void redpack::setfee(const extended_asset &fee) {
    _gstate2.fee = fee;
 }
 
+void redpack::setholdsync(const bool &synced) {
+   require_auth(_self);
+
+   _gstate2.holders_synced = synced;
+}
+
 void redpack::deltoken(const uint64_t &token_id) {
    require_auth(_self);
 
@@ -216,12 +222,23 @@ void redpack::claimredpack(const name &claimer, const name &code, const string &
 
    bool is_auth = false;
    if ((redpack_type)redpack.type == redpack_type::DID_RANDOM || (redpack_type)redpack.type == redpack_type::DID_MEAN) {
-      auto claimer_acnts = amax::account_t::idx_t(_gstate2.did_contract, claimer.value);
-      bool is_auth       = false;
-      for (auto claimer_acnts_iter = claimer_acnts.begin(); claimer_acnts_iter != claimer_acnts.end(); claimer_acnts_iter++) {
-         if (claimer_acnts_iter->balance.amount > 0) {
-            is_auth = true;
-            break;
+      auto holders     = amax::holder_t::idx_t(_gstate2.did_contract, _gstate2.did_contract.value);
+      auto holder_iter = holders.find(claimer.value);
+      bool is_auth     = holder_iter != holders.end() && !holder_iter->dids.empty();
+
+      // holders not yet backfilled by did.ntoken syncholders are only found through their balances
+      if (!is_auth && !_gstate2.holders_synced.value_or(false)) {
+         auto claimer_acnts = amax::account_v2_t::idx_t(_gstate2.did_contract, claimer.value);
+         for (auto claimer_acnts_iter = claimer_acnts.begin(); claimer_acnts_iter != claimer_acnts.end(); claimer_acnts_iter++) {
+            if (claimer_acnts_iter->get_amount() > 0) {
+               is_auth = true;
+               break;
+            }
+         }
+         // accounts not yet migrated by did.ntoken still hold their DID in the legacy table
+         auto legacy_acnts = amax::account_t::idx_t(_gstate2.did_contract, claimer.value);
+         for (auto legacy_iter = legacy_acnts.begin(); !is_auth && legacy_iter != legacy_acnts.end(); legacy_iter++) {
+            if (legacy_iter->balance.amount > 0) is_auth = true;
          }
       }
       CHECKC(is_auth, err::DID_NOT_AUTH, "did is not authenticated");
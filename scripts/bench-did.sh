@@ -0,0 +1,105 @@
+#!/usr/bin/env bash
+# Drives synthetic KYC orders through amax.did on a local test chain and reports
+# per-action cost at growing table sizes, as CSV on stdout:
+#
+#   table_size,action,order_state,cpu_us,net_bytes,wall_ms
+#
+# Usage: VENDOR=amax.daodev KYC_LEVEL=1 CHARGE="0.05000000 AMAX" ./bench-did.sh 1000 5000 10000
+#
+# Each size is a checkpoint: orders are created until that many were placed in total,
+# then SAMPLES orders are settled per state (pending, ok, nok) plus one setdidstatuses
+# batch of SAMPLES orders. Applicant accounts are created on the fly, funded by FUNDER.
+# Requires a local amnod with amax.did initialized and the vendor added, and jq.
+#
+# Supported scale: amax.did keeps one open order per applicant, so a checkpoint of N
+# orders needs N applicant accounts, each created with its own newaccount and 4 KB of
+# RAM. That is practical up to about 10^4 orders on a local chain. Checkpoints above
+# MAX_SIZE (default 20000) are refused. The 10^5-10^6 range needs the tables
+# populated another way, for example by restoring a snapshot taken from a seeded
+# chain; set MAX_SIZE to override the guard.
+
+set -eo pipefail
+
+AMCLI=${AMCLI:-"amcli -u http://127.0.0.1:8888"}
+CONTRACT=${CONTRACT:-amax.did}
+ADMIN=${ADMIN:-armoniaadmin}
+FUNDER=${FUNDER:-armoniaadmin}
+VENDOR=${VENDOR:-amax.daodev}
+KYC_LEVEL=${KYC_LEVEL:-1}
+CHARGE=${CHARGE:-"0.05000000 AMAX"}
+SAMPLES=${SAMPLES:-20}
+MAX_SIZE=${MAX_SIZE:-20000}
+PUBKEY=${PUBKEY:-$($AMCLI wallet keys | jq -r '.[0]')}
+
+created=0
+cost=""
+
+function applicant_name() {
+    # 12-char account names from a counter, base-31 digits in [a-z1-5]
+    local n=$1 chars="abcdefghijklmnopqrstuvwxyz12345" s=""
+    for i in $(seq 1 7); do s="${chars:$((n % 31)):1}$s"; n=$((n / 31)); done
+    echo "bench$s"
+}
+
+function push() {
+    # push one action and print cpu_us,net_bytes,wall_ms
+    local start=$(date +%s%N)
+    local trx=$($AMCLI push action "$@" --json)
+    local end=$(date +%s%N)
+    echo "$trx" | jq -r --arg wall $(( (end - start) / 1000000 )) \
+        '"\(.processed.receipt.cpu_usage_us),\(.processed.receipt.net_usage_words * 8),\($wall)"'
+}
+
+function order_id_of() {
+    $AMCLI get table $CONTRACT $CONTRACT applicants -L $1 -U $1 | jq -r '.rows[0].order_id'
+}
+
+function create_order() {
+    # sets $cost, not run in a subshell so that $created keeps counting
+    local applicant=$(applicant_name $created)
+    $AMCLI system newaccount $FUNDER $applicant $PUBKEY --buy-ram-kbytes 4 \
+        --stake-net "0.01000000 AMAX" --stake-cpu "0.01000000 AMAX" >/dev/null 2>&1
+    $AMCLI transfer $FUNDER $applicant "$CHARGE" "bench" >/dev/null
+
+    local md5=$(echo -n "$applicant" | md5sum | cut -d' ' -f1)
+    cost=$(push amax.token transfer \
+        '["'$applicant'","'$CONTRACT'","'"$CHARGE"'","'$VENDOR:$KYC_LEVEL:$md5'"]' -p $applicant)
+    created=$((created + 1))
+}
+
+function settle_sample() {
+    # settles SAMPLES orders starting from counter $2 with status $3
+    local size=$1 first=$2 status=$3
+    for i in $(seq 0 $((SAMPLES - 1))); do
+        local order_id=$(order_id_of $(applicant_name $((first + i))))
+        echo "$size,setdidstatus,$status,$(push $CONTRACT setdidstatus '['$order_id',"'$status'","bench"]' -p $ADMIN)"
+    done
+}
+
+for size in "$@"; do
+    if [[ $size -gt $MAX_SIZE ]]; then
+        echo "checkpoint $size exceeds MAX_SIZE=$MAX_SIZE, one account is created per order" >&2
+        exit 1
+    fi
+done
+
+for size in "$@"; do
+    while [[ $created -lt $size ]]; do
+        create_order
+        # only report the tail of each step, the head is warm-up
+        [[ $((size - created)) -lt $SAMPLES ]] && echo "$size,ontransfer,new,$cost"
+    done
+
+    # the most recent orders are settled, so the table size stays close to the checkpoint
+    tail=$((created - SAMPLES * 3))
+    settle_sample $size $tail pending
+    settle_sample $size $((tail + SAMPLES)) ok
+    settle_sample $size $((tail + SAMPLES * 2)) nok
+
+    results=""
+    for i in $(seq 1 $SAMPLES); do
+        create_order
+        results+='{"order_id":'$(order_id_of $(applicant_name $((created - 1))))',"status":"ok","msg":""},'
+    done
+    echo "$size,setdidstatuses,ok,$(push $CONTRACT setdidstatuses '[['${results%,}']]' -p $ADMIN)"
+done